@@ -0,0 +1,126 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "agg_color_rgba.h"
+#include "agg_rendering_buffer.h"
+
+namespace bar {
+
+// an opaque picture bar frames start from instead of transparent black, bgra bytes in rows of w pixels
+struct backdrop_t {
+  unsigned w = 0;
+  unsigned h = 0;
+  std::vector<uint8_t> px;
+
+  bool empty() const noexcept { return px.empty(); }
+
+  int stride() const noexcept { return static_cast<int>(w) * 4; }
+
+  agg::rendering_buffer rbuf() const { return agg::rendering_buffer{ const_cast<uint8_t *>(px.data()), w, h, stride() }; }
+};
+
+namespace detail {
+
+// running sums divide by 2r+1 as a 16 bit fixed point multiply, exact to within one level and free of divisions
+struct box_div_t {
+  explicit box_div_t(unsigned r) : mul_((65536 + r) / (2 * r + 1)) {}
+
+  uint8_t operator()(uint32_t sum) const noexcept { return static_cast<uint8_t>(std::min<uint32_t>((sum * mul_ + 32768) >> 16, 255)); }
+
+  uint32_t mul_;
+};
+
+// one horizontal box pass over a row of n bgra pixels, edges repeat the outermost pixel. the four channels move
+// together so the compiler keeps the sums in one vector register
+inline void box_blur_row(const uint8_t *src, uint8_t *dst, unsigned n, unsigned r) {
+  box_div_t div{ r };
+  uint32_t sum[4] = { 0, 0, 0, 0 };
+  auto at = [&](long i) { return src + std::clamp<long>(i, 0, static_cast<long>(n) - 1) * 4; };
+  for(long i = -static_cast<long>(r); i <= static_cast<long>(r); i++)
+    for(int c = 0; c < 4; c++)
+      sum[c] += at(i)[c];
+  for(unsigned i = 0; i < n; i++) {
+    const uint8_t *in = at(static_cast<long>(i) + r + 1);
+    const uint8_t *out = at(static_cast<long>(i) - r);
+    for(int c = 0; c < 4; c++) {
+      dst[i * 4 + c] = div(sum[c]);
+      sum[c] += in[c] - out[c];
+    }
+  }
+}
+
+// one vertical box pass, a whole row of sums is advanced at a time so the inner loops run over contiguous bytes and
+// vectorize across the row
+inline void box_blur_cols(const uint8_t *src, uint8_t *dst, unsigned w, unsigned h, unsigned r, std::vector<uint32_t> &sum) {
+  box_div_t div{ r };
+  std::size_t n = std::size_t(w) * 4;
+  auto row = [&](long y) { return src + std::clamp<long>(y, 0, static_cast<long>(h) - 1) * n; };
+  sum.assign(n, 0);
+  for(long y = -static_cast<long>(r); y <= static_cast<long>(r); y++) {
+    const uint8_t *p = row(y);
+    for(std::size_t i = 0; i < n; i++)
+      sum[i] += p[i];
+  }
+  for(unsigned y = 0; y < h; y++) {
+    uint8_t *d = dst + y * n;
+    const uint8_t *in = row(static_cast<long>(y) + r + 1);
+    const uint8_t *out = row(static_cast<long>(y) - r);
+    for(std::size_t i = 0; i < n; i++) {
+      d[i] = div(sum[i]);
+      sum[i] += in[i] - out[i];
+    }
+  }
+}
+
+}
+
+// the w x h rectangle at (x, y) of a bgra image, blurred with three box passes (close to a gaussian of about r) and
+// tinted towards tint by tint.a. rows around the rectangle take part in the blur so its edges do not smear inwards.
+// done once per wallpaper, a frame only copies the result
+inline backdrop_t make_backdrop(const uint8_t *img, int img_stride, unsigned img_w, unsigned img_h, unsigned x, unsigned y, unsigned w, unsigned h,
+                                unsigned r, agg::rgba8 tint) {
+  backdrop_t drop;
+  if(x >= img_w || y >= img_h || w == 0 || h == 0)
+    return drop;
+  w = std::min(w, img_w - x);
+  h = std::min(h, img_h - y);
+
+  unsigned pad = 3 * r;
+  unsigned y0 = y > pad ? y - pad : 0;
+  unsigned y1 = std::min(img_h, y + h + pad);
+  unsigned ch = y1 - y0;
+  std::size_t n = std::size_t(w) * 4;
+
+  std::vector<uint8_t> a(n * ch), b(n * ch);
+  for(unsigned j = 0; j < ch; j++) {
+    uint8_t *d = a.data() + j * n;
+    std::memcpy(d, img + std::size_t(y0 + j) * img_stride + std::size_t(x) * 4, n);
+    for(unsigned i = 0; i < w; i++)
+      d[i * 4 + 3] = 255;
+  }
+
+  if(r > 0) {
+    std::vector<uint32_t> sum;
+    for(int pass = 0; pass < 3; pass++) {
+      for(unsigned j = 0; j < ch; j++)
+        detail::box_blur_row(a.data() + j * n, b.data() + j * n, w, r);
+      detail::box_blur_cols(b.data(), a.data(), w, ch, r, sum);
+    }
+  }
+
+  drop.w = w;
+  drop.h = h;
+  drop.px.assign(a.begin() + (y - y0) * n, a.begin() + (y - y0 + h) * n);
+  const uint8_t tc[3] = { tint.b, tint.g, tint.r };
+  for(std::size_t i = 0; i < drop.px.size(); i += 4)
+    for(int c = 0; c < 3; c++)
+      drop.px[i + c] = static_cast<uint8_t>((drop.px[i + c] * (255 - tint.a) + tc[c] * tint.a + 127) / 255);
+  return drop;
+}
+
+}
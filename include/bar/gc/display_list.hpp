@@ -0,0 +1,189 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "bar/gc/gc.hpp"
+#include "bar/layout/zone.hpp"
+#include "ytk/misc/frame_arena.hpp"
+
+namespace bar {
+
+// one recorded primitive, kept free of padding so a list can be compared byte for byte
+struct display_op_t {
+  enum class kind_t : uint32_t { panel_bg, panel_pin, text, volbar, ltbutton_icon };
+
+  double x = 0;
+  double y = 0;
+  double w = 0;
+  double h = 0;
+  double v = 0; // volbar rate, pin size
+  kind_t kind = kind_t::panel_bg;
+  panel_flavor_t flavor = panel_flavor_t::none;
+  ltbutton_icon_t icon = ltbutton_icon_t::floating;
+  uint32_t text_len = 0;
+
+  // pixels the primitive may touch, text is confined to its box by centering or fading
+  bool overlaps(double x1, double y1, double x2, double y2) const {
+    double ox = x, oy = y, ow = w, oh = h;
+    if(kind == kind_t::panel_pin) {
+      ow = oh = v;
+    } else if(kind == kind_t::text) {
+      oy = y - h * 2;
+      oh = h * 3;
+    }
+    return ox < x2 && ox + ow > x1 && oy < y2 && oy + oh > y1;
+  }
+};
+
+static_assert(sizeof(display_op_t) == 5 * sizeof(double) + 4 * sizeof(uint32_t));
+
+// a recorded list, either a recorder's own buffers or a copy in a frame arena
+struct display_list_view_t {
+  const display_op_t *ops = nullptr;
+  std::size_t size = 0;
+  std::string_view text;
+
+  // plays the list back into any gc with the primitive and path api of agg_gc_t, pins and floating icons of one color are
+  // gathered into a single pass as long as nothing recorded in between overlaps them, several workers may replay one list
+  // into disjoint clip boxes
+  template <class Gc> void replay(Gc &gc) const {
+    using kind_t = display_op_t::kind_t;
+    auto batched = [](const display_op_t &op) {
+      return op.kind == kind_t::panel_pin || (op.kind == kind_t::ltbutton_icon && op.icon == ltbutton_icon_t::floating);
+    };
+    // a color change flushes, so every batchable op in [batch_begin, batch_end) belongs to the pending batch
+    std::size_t batch_begin = 0, batch_end = 0;
+    agg::rgba8 batch_color;
+    double bx1 = 0, by1 = 0, bx2 = 0, by2 = 0;
+    auto flush = [&]() {
+      if(batch_begin == batch_end)
+        return;
+      gc.begin_paths();
+      for(std::size_t i = batch_begin; i < batch_end; i++) {
+        const display_op_t &op = ops[i];
+        if(op.kind == kind_t::panel_pin)
+          gc.add_panel_pin(op.x, op.y, op.v);
+        else if(batched(op))
+          gc.add_floating_icon(op.x, op.y, op.w, op.h);
+      }
+      gc.fill_paths(batch_color);
+      batch_begin = batch_end;
+    };
+
+    const char *txt = text.data();
+    for(std::size_t i = 0; i < size; i++) {
+      const display_op_t &op = ops[i];
+      if(batched(op)) {
+        const panel_style_t &style = pstyles()[op.flavor];
+        agg::rgba8 color = op.kind == kind_t::panel_pin ? style.pin : style.fg;
+        if(batch_begin != batch_end && (color.r != batch_color.r || color.g != batch_color.g || color.b != batch_color.b || color.a != batch_color.a))
+          flush();
+        double x2 = op.x + (op.kind == kind_t::panel_pin ? op.v : op.w);
+        double y2 = op.y + (op.kind == kind_t::panel_pin ? op.v : op.h);
+        if(batch_begin == batch_end) {
+          batch_color = color;
+          batch_begin = i;
+          bx1 = op.x, by1 = op.y, bx2 = x2, by2 = y2;
+        } else {
+          bx1 = std::min(bx1, op.x), by1 = std::min(by1, op.y), bx2 = std::max(bx2, x2), by2 = std::max(by2, y2);
+        }
+        batch_end = i + 1;
+        continue;
+      }
+
+      if(batch_begin != batch_end && op.overlaps(bx1, by1, bx2, by2))
+        flush();
+      switch(op.kind) {
+      case kind_t::panel_bg:
+        gc.draw_panel_bg(op.x, op.y, op.w, op.h, op.flavor);
+        break;
+      case kind_t::text:
+        gc.draw_text(std::string_view{ txt, op.text_len }, op.x, op.y, op.w, op.h, op.flavor);
+        txt += op.text_len;
+        break;
+      case kind_t::volbar:
+        gc.draw_volbar(op.v, op.x, op.y, op.w, op.h, op.flavor);
+        break;
+      case kind_t::ltbutton_icon:
+        gc.draw_ltbutton_icon(op.icon, op.x, op.y, op.w, op.h, op.flavor);
+        break;
+      default:
+        break;
+      }
+    }
+    flush();
+  }
+};
+
+// records draw calls instead of rendering them, snapshot() feeds the list to a zone_snapshot_t so identical frames are skipped
+struct recording_gc_t : zone_draw_t<recording_gc_t> {
+  using zone_api = zone_draw_t<recording_gc_t>;
+  using zone_api::draw_ltbutton_icon;
+  using zone_api::draw_panel_bg;
+  using zone_api::draw_panel_pin;
+  using zone_api::draw_text;
+  using zone_api::draw_volbar;
+
+  using kind_t = display_op_t::kind_t;
+
+  void draw_volbar(double rate, double x, double y, double w, double h, panel_flavor_t flavor = panel_flavor_t::none) {
+    push(kind_t::volbar, x, y, w, h, flavor).v = rate;
+  }
+
+  void draw_ltbutton_icon(ltbutton_icon_t icon, double x, double y, double w, double h, panel_flavor_t flavor = panel_flavor_t::none) {
+    push(kind_t::ltbutton_icon, x, y, w, h, flavor).icon = icon;
+  }
+
+  void draw_panel_bg(double x, double y, double w, double h, panel_flavor_t flavor = panel_flavor_t::none) { push(kind_t::panel_bg, x, y, w, h, flavor); }
+
+  void draw_panel_pin(double x, double y, double a, panel_flavor_t flavor = panel_flavor_t::none) { push(kind_t::panel_pin, x, y, 0, 0, flavor).v = a; }
+
+  // the whole string is kept, the renderer shapes it and cuts it at the fade, so recording never touches the fonts
+  void draw_text(std::string_view txt, double x, double bl_y, double w, double h, panel_flavor_t flavor = panel_flavor_t::none) {
+    push(kind_t::text, x, bl_y, w, h, flavor).text_len = static_cast<uint32_t>(txt.size());
+    text_.append(txt);
+  }
+
+  void clear() {
+    ops_.clear();
+    text_.clear();
+  }
+
+  bool empty() const noexcept { return ops_.empty(); }
+
+  void snapshot(zone_snapshot_t &snap) const {
+    snap.add(std::string_view{ reinterpret_cast<const char *>(ops_.data()), ops_.size() * sizeof(display_op_t) });
+    snap.add(std::string_view{ text_ });
+  }
+
+  display_list_view_t view() const noexcept { return display_list_view_t{ ops_.data(), ops_.size(), text_ }; }
+
+  // the list copied into storage that lives as long as the frame, the recorder keeps its buffers for the next zone
+  display_list_view_t copy_to(ytk::frame_arena_t &arena) const {
+    const char *text = arena.copy(text_.data(), text_.size());
+    return display_list_view_t{ arena.copy(ops_.data(), ops_.size()), ops_.size(), std::string_view{ text, text_.size() } };
+  }
+
+  template <class Gc> void replay(Gc &gc) const { view().replay(gc); }
+
+private:
+  display_op_t &push(kind_t kind, double x, double y, double w, double h, panel_flavor_t flavor) {
+    display_op_t &op = ops_.emplace_back();
+    op.kind = kind;
+    op.x = x;
+    op.y = y;
+    op.w = w;
+    op.h = h;
+    op.flavor = flavor;
+    return op;
+  }
+
+  std::vector<display_op_t> ops_;
+  std::string text_;
+};
+
+}
@@ -0,0 +1,731 @@
+#pragma once
+
+#include "agg_basics.h"
+#include "agg_conv_contour.h"
+#include "agg_conv_curve.h"
+#include "agg_font_cache_manager.h"
+#include "agg_font_freetype.h"
+
+#include "utf8proc.h"
+#include "ytk/misc/common.hpp"
+
+#include "fontconfig/fontconfig.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iterator>
+#include <limits>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace bar {
+
+using font_token_t = uint32_t;
+
+struct font_cache_stats_t {
+  std::size_t bytes = 0;
+  std::size_t items = 0;
+  uint64_t hits = 0;
+  uint64_t misses = 0;
+  uint64_t evictions = 0;
+};
+
+// one memory budget shared by font entries and glyph masks, the least recently used of either is evicted first
+struct font_cache_budget_t {
+  static constexpr std::size_t default_bytes = 16 << 20;
+  static constexpr uint64_t never = std::numeric_limits<uint64_t>::max();
+
+  uint64_t touch() { return ++tick_; }
+
+  std::size_t bytes_ = default_bytes;
+  uint64_t tick_ = 0;
+};
+
+inline font_cache_budget_t &fbudget() {
+  static font_cache_budget_t b;
+  return b;
+}
+
+// the font layer is shared by the bar render workers, every use of the singletons in this file holds this lock
+inline std::mutex &font_mutex() {
+  static std::mutex m;
+  return m;
+}
+
+// evicts until both caches fit fbudget(), defined after the caches
+inline void trim_font_caches();
+
+// codepoint -> font memo, kept as coalesced [first, last] ranges so a whole unicode block costs a single node
+struct font_range_memo_t {
+  struct range_t {
+    uint32_t last;
+    font_token_t tok;
+  };
+
+  std::optional<font_token_t> find(uint32_t code) const {
+    auto it = ranges_.upper_bound(code);
+    if(it == ranges_.begin())
+      return std::nullopt;
+    --it;
+    if(code > it->second.last)
+      return std::nullopt;
+    return it->second.tok;
+  }
+
+  // [first, last] must not overlap any range already inserted
+  void insert(uint32_t first, uint32_t last, font_token_t tok) {
+    auto next = ranges_.lower_bound(first);
+    if(next != ranges_.begin()) {
+      auto prev = std::prev(next);
+      if(prev->second.last + 1 == first && prev->second.tok == tok) {
+        first = prev->first;
+        ranges_.erase(prev);
+      }
+    }
+    if(next != ranges_.end() && next->first == last + 1 && next->second.tok == tok) {
+      last = next->second.last;
+      ranges_.erase(next);
+    }
+    ranges_[first] = range_t{ last, tok };
+  }
+
+  std::map<uint32_t, range_t> ranges_;
+};
+
+// result of FcFontSort for one selector, along with each font's FC_CHARSET coverage
+struct font_selection_t {
+  font_selection_t() = default;
+  font_selection_t(const font_selection_t &) = delete;
+  font_selection_t &operator=(const font_selection_t &) = delete;
+  font_selection_t(font_selection_t &&) = default;
+  font_selection_t &operator=(font_selection_t &&) = default;
+
+  ~font_selection_t() {
+    for(FcCharSet *cs : charsets_) {
+      if(cs)
+        FcCharSetDestroy(cs);
+    }
+  }
+
+  void add(font_token_t tok, FcCharSet *cs) {
+    tokens_.push_back(tok);
+    charsets_.push_back(cs ? FcCharSetCopy(cs) : nullptr);
+  }
+
+  bool empty() const { return tokens_.empty(); }
+
+  font_token_t front() const { return tokens_.front(); }
+
+  // first font in sort order covering code, 0 if none does
+  font_token_t covering(uint32_t code) const {
+    for(std::size_t i = 0; i < tokens_.size(); i++) {
+      if(charsets_[i] && FcCharSetHasChar(charsets_[i], code))
+        return tokens_[i];
+    }
+    return 0;
+  }
+
+  // a miss resolves the whole 256-codepoint page around code, so neighbouring codepoints are answered by the memo
+  font_token_t resolve(uint32_t code) {
+    if(auto tok = memo_.find(code))
+      return *tok;
+    uint32_t page_first = code & ~0xffu;
+    uint32_t page_last = page_first | 0xffu;
+    uint32_t run_first = page_first;
+    font_token_t run_tok = covering(page_first);
+    for(uint32_t c = page_first + 1; c <= page_last; c++) {
+      font_token_t tok = covering(c);
+      if(tok != run_tok) {
+        memo_.insert(run_first, c - 1, run_tok);
+        run_first = c;
+        run_tok = tok;
+      }
+    }
+    memo_.insert(run_first, page_last, run_tok);
+    return covering(code);
+  }
+
+  std::vector<font_token_t> tokens_;
+  std::vector<FcCharSet *> charsets_;
+  font_range_memo_t memo_;
+};
+
+struct font_matcher_t {
+  font_matcher_t() { conf_ = FcInitLoadConfigAndFonts(); }
+
+  // how often fontconfig is asked whether installed fonts or its config changed
+  static constexpr std::chrono::seconds uptodate_interval{ 30 };
+
+  font_token_t get_or_create_token(const std::string &path) {
+    auto it = file_to_token_.find(path);
+    if(it == file_to_token_.end()) {
+      font_token_t tok = next_token_++;
+      file_to_token_.emplace(path, tok);
+      token_to_file_.emplace(tok, path);
+      return tok;
+    }
+    return it->second;
+  }
+
+  const std::string &get_path(font_token_t tok) const { return token_to_file_.at(tok); }
+
+  void check_uptodate() {
+    auto now = std::chrono::steady_clock::now();
+    if(now - last_uptodate_check_ < uptodate_interval)
+      return;
+    last_uptodate_check_ = now;
+    if(FcConfigUptoDate(conf_))
+      return;
+    ytk::log::info("fontconfig: fonts changed, reloading");
+    FcConfigDestroy(conf_);
+    conf_ = FcInitLoadConfigAndFonts();
+    sorted_.clear();
+    generation_++;
+  }
+
+  // sorted fonts for a selector, fontconfig is consulted once per selector until fonts change
+  font_selection_t &match_fonts(const std::string &sel) {
+    check_uptodate();
+    auto it = sorted_.find(sel);
+    if(it == sorted_.end()) {
+      it = sorted_.emplace(sel, sort_fonts(sel)).first;
+    }
+    return it->second;
+  }
+
+  font_selection_t sort_fonts(const std::string &sel) {
+    font_selection_t fonts;
+
+    FcResult result;
+    FcPattern *pat = FcNameParse(reinterpret_cast<const FcChar8 *>(sel.c_str()));
+    if(!pat)
+      ytk::raise("FcNameParse(\"{}\") failed", sel);
+
+    FcConfigSubstitute(conf_, pat, FcMatchPattern);
+    FcDefaultSubstitute(pat);
+
+    FcFontSet *fs = FcFontSort(conf_, pat, FcTrue, 0, &result);
+    if(fs) {
+      for(unsigned i = 0; i < fs->nfont; i++) {
+        FcValue v;
+        FcPatternGet(fs->fonts[i], FC_FILE, 0, &v);
+        std::string path{ reinterpret_cast<const char *>(v.u.f) };
+        FcCharSet *cs = nullptr;
+        if(FcPatternGetCharSet(fs->fonts[i], FC_CHARSET, 0, &cs) != FcResultMatch)
+          cs = nullptr;
+        fonts.add(get_or_create_token(path), cs);
+      }
+      FcFontSetSortDestroy(fs);
+    }
+    FcPatternDestroy(pat);
+    return fonts;
+  }
+
+  FcConfig *conf_ = nullptr;
+  font_token_t next_token_ = 1;
+  std::map<std::string, font_token_t> file_to_token_;
+  std::map<font_token_t, std::string> token_to_file_;
+  std::map<std::string, font_selection_t> sorted_;
+  uint64_t generation_ = 0;
+  std::chrono::steady_clock::time_point last_uptodate_check_ = std::chrono::steady_clock::now();
+};
+
+inline font_matcher_t &fmatcher() {
+  static font_matcher_t m;
+  return m;
+}
+
+// a font file mapped read-only once, faces of every size are created from the same pages
+struct font_file_t {
+  explicit font_file_t(const std::string &path) : path_(path) {
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if(fd < 0)
+      ytk::raise("font file not found : {}", path);
+    struct stat st;
+    if(::fstat(fd, &st) < 0 || st.st_size <= 0) {
+      ::close(fd);
+      ytk::raise("font file not readable : {}", path);
+    }
+    size_ = st.st_size;
+    void *addr = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if(addr == MAP_FAILED)
+      ytk::raise("font file not mappable : {}", path);
+    data_ = static_cast<const char *>(addr);
+  }
+
+  font_file_t(const font_file_t &) = delete;
+  font_file_t &operator=(const font_file_t &) = delete;
+
+  ~font_file_t() { ::munmap(const_cast<char *>(data_), size_); }
+
+  std::string path_;
+  const char *data_ = nullptr;
+  std::size_t size_ = 0;
+};
+
+// the mapping lives as long as some entry of any size still uses it
+struct font_file_registry_t {
+  std::shared_ptr<font_file_t> open(font_token_t tok) {
+    auto &weak = files_[tok];
+    if(auto file = weak.lock())
+      return file;
+    auto file = std::make_shared<font_file_t>(fmatcher().get_path(tok));
+    weak = file;
+    return file;
+  }
+
+  std::map<font_token_t, std::weak_ptr<font_file_t>> files_;
+};
+
+inline font_file_registry_t &ffiles() {
+  static font_file_registry_t r;
+  return r;
+}
+
+// counts what font_cache_manager generates, it only calls prepare_glyph on a cache miss
+struct agg_counting_font_engine_t : agg::font_engine_freetype_int32 {
+  // an entry only ever loads its one face
+  agg_counting_font_engine_t() : agg::font_engine_freetype_int32(1) {}
+
+  bool prepare_glyph(unsigned glyph_code) {
+    if(!agg::font_engine_freetype_int32::prepare_glyph(glyph_code))
+      return false;
+    generated_++;
+    glyph_bytes_ += data_size() + sizeof(agg::glyph_cache);
+    return true;
+  }
+
+  uint64_t generated_ = 0;
+  std::size_t glyph_bytes_ = 0;
+};
+
+// one face at one pixel height, the engine size never changes so its glyph cache is never invalidated
+struct agg_font_entry_t {
+  // rough cost of an open FT_Face with its loaded tables, on top of the cached glyphs
+  static constexpr std::size_t face_bytes = 128 << 10;
+
+  typedef agg_counting_font_engine_t font_engine_type;
+  typedef agg::font_cache_manager<font_engine_type> font_manager_type;
+
+  agg_font_entry_t(std::shared_ptr<font_file_t> file, unsigned px) : file_(std::move(file)) {
+    if(!feng_.load_font(file_->path_.c_str(), 0, agg::glyph_ren_outline, file_->data_, file_->size_)) {
+      ytk::raise("font file not loadable : {}", file_->path_);
+    }
+    feng_.height(px);
+    curves_.approximation_scale(2.0);
+    contour_.auto_detect_orientation(false);
+    contour_.width(0.5);
+    feng_.flip_y(true);
+  }
+
+  const auto *glyph(uint_least32_t code) { return curr_glyph_ = fman_.glyph(code); }
+
+  std::size_t bytes() const { return face_bytes + feng_.glyph_bytes_; }
+
+  auto &vertex_source(double x, double y) {
+    fman_.init_embedded_adaptors(curr_glyph_, x, y);
+    return contour_;
+  }
+
+  std::shared_ptr<font_file_t> file_;
+  font_engine_type feng_;
+  font_manager_type fman_{ feng_, 1 };
+  const agg::glyph_cache *curr_glyph_ = nullptr;
+  agg::conv_curve<font_manager_type::path_adaptor_type> curves_{ fman_.path_adaptor() };
+  agg::conv_contour<agg::conv_curve<font_manager_type::path_adaptor_type>> contour_{ curves_ };
+};
+
+using font_entry_key_t = std::pair<font_token_t, unsigned>;
+
+struct agg_font_context_t {
+  struct slot_t {
+    std::unique_ptr<agg_font_entry_t> ent;
+    std::list<font_entry_key_t>::iterator lru;
+    uint64_t used = 0;
+  };
+
+  void select(const std::string &sel) { curr_sel_ = &fmatcher().match_fonts(sel); }
+
+  void height(unsigned px) { curr_height_ = px; }
+
+  agg_font_entry_t &get_or_create_entry(font_token_t tok, unsigned px) {
+    font_entry_key_t key{ tok, px };
+    auto it = entries_.find(key);
+    if(it != entries_.end()) {
+      stats_.hits++;
+      lru_.splice(lru_.begin(), lru_, it->second.lru);
+      it->second.used = fbudget().touch();
+      return *it->second.ent;
+    }
+    stats_.misses++;
+    lru_.push_front(key);
+    slot_t slot{ std::make_unique<agg_font_entry_t>(ffiles().open(tok), px), lru_.begin(), fbudget().touch() };
+    stats_.bytes += slot.ent->bytes();
+    stats_.items++;
+    agg_font_entry_t &ent = *entries_.emplace(key, std::move(slot)).first->second.ent;
+    trim_font_caches();
+    return ent;
+  }
+
+  // only the font whose charset covers code is ever opened, anything uncovered becomes a tofu of the first font
+  const agg::glyph_cache *glyph(uint_least32_t code) {
+    if(curr_sel_->empty())
+      return nullptr;
+    font_token_t tok = curr_sel_->resolve(code);
+    if(tok) {
+      if(auto *glyph_ptr = glyph_from(tok, code))
+        return glyph_ptr;
+    }
+    return glyph_from(curr_sel_->front(), 0);
+  }
+
+  const agg::glyph_cache *glyph_from(font_token_t tok, uint_least32_t code) {
+    auto &ent = get_or_create_entry(tok, curr_height_);
+    std::size_t bytes_before = ent.bytes();
+    uint64_t generated_before = ent.feng_.generated_;
+    auto *glyph_ptr = ent.glyph(code);
+    if(ent.feng_.generated_ == generated_before) {
+      glyph_stats_.hits++;
+    } else {
+      glyph_stats_.misses++;
+      glyph_stats_.items++;
+      stats_.bytes += ent.bytes() - bytes_before;
+      trim_font_caches();
+    }
+    if(glyph_ptr) {
+      curr_ent_ = &ent;
+      curr_tok_ = tok;
+      curr_code_ = code;
+    }
+    return glyph_ptr;
+  }
+
+  auto &vertex_source(double x, double y) { return curr_ent_->vertex_source(x, y); }
+
+  // last use of the least recently used entry, the most recent one is never evictable as it may be curr_ent_
+  uint64_t oldest_use() const {
+    if(lru_.size() <= 1)
+      return font_cache_budget_t::never;
+    return entries_.at(lru_.back()).used;
+  }
+
+  void evict_oldest() {
+    auto it = entries_.find(lru_.back());
+    stats_.bytes -= it->second.ent->bytes();
+    stats_.items--;
+    stats_.evictions++;
+    glyph_stats_.items -= it->second.ent->feng_.generated_;
+    glyph_stats_.evictions += it->second.ent->feng_.generated_;
+    entries_.erase(it);
+    lru_.pop_back();
+  }
+
+  // glyph_stats_.bytes stays 0, outline bytes are accounted to the entry owning them in stats_
+  const font_cache_stats_t &stats() const { return stats_; }
+  const font_cache_stats_t &glyph_stats() const { return glyph_stats_; }
+
+  font_selection_t *curr_sel_ = nullptr;
+  agg_font_entry_t *curr_ent_ = nullptr;
+  font_token_t curr_tok_ = 0;
+  uint_least32_t curr_code_ = 0;
+  unsigned curr_height_ = 50;
+  std::map<font_entry_key_t, slot_t> entries_;
+  std::list<font_entry_key_t> lru_;
+  font_cache_stats_t stats_;
+  font_cache_stats_t glyph_stats_;
+};
+
+inline agg_font_context_t &fctx() {
+  static agg_font_context_t ctx;
+  return ctx;
+}
+
+// glyphs are positioned at 1/glyph_subpixel_steps px horizontally, baselines are snapped to whole pixels
+constexpr unsigned glyph_subpixel_steps = 4;
+
+struct glyph_mask_key_t {
+  font_token_t tok = 0;
+  unsigned height = 0;
+  uint32_t code = 0;
+  unsigned subpx = 0;
+
+  bool operator==(const glyph_mask_key_t &rhs) const { return tok == rhs.tok && height == rhs.height && code == rhs.code && subpx == rhs.subpx; }
+};
+
+struct glyph_mask_key_hash_t {
+  std::size_t operator()(const glyph_mask_key_t &k) const {
+    uint64_t h = (uint64_t(k.tok) << 40) ^ (uint64_t(k.height) << 24) ^ (uint64_t(k.subpx) << 21) ^ k.code;
+    return std::hash<uint64_t>{}(h);
+  }
+};
+
+// 8-bit coverage of a rasterized glyph, (x, y) is the top-left cell relative to the pen position on the baseline
+struct glyph_mask_t {
+  int x = 0;
+  int y = 0;
+  unsigned w = 0;
+  unsigned h = 0;
+  std::vector<agg::int8u> covers;
+
+  const agg::int8u *row(unsigned r) const { return covers.data() + r * w; }
+
+  std::size_t bytes() const { return sizeof(glyph_mask_t) + covers.capacity(); }
+};
+
+struct glyph_mask_cache_t {
+  // shared so a worker can keep blending a mask that another one has just evicted
+  using mask_ptr_t = std::shared_ptr<const glyph_mask_t>;
+
+  struct slot_t {
+    mask_ptr_t mask;
+    std::list<glyph_mask_key_t>::iterator lru;
+    uint64_t used = 0;
+  };
+
+  mask_ptr_t find(const glyph_mask_key_t &key) {
+    auto it = masks_.find(key);
+    if(it == masks_.end()) {
+      stats_.misses++;
+      return nullptr;
+    }
+    stats_.hits++;
+    lru_.splice(lru_.begin(), lru_, it->second.lru);
+    it->second.used = fbudget().touch();
+    return it->second.mask;
+  }
+
+  // masks are rasterized outside the lock, when two workers raced for the same glyph the first one to insert wins
+  mask_ptr_t insert(const glyph_mask_key_t &key, glyph_mask_t &&mask) {
+    auto it = masks_.find(key);
+    if(it != masks_.end()) {
+      lru_.splice(lru_.begin(), lru_, it->second.lru);
+      it->second.used = fbudget().touch();
+      return it->second.mask;
+    }
+    lru_.push_front(key);
+    stats_.bytes += mask.bytes();
+    stats_.items++;
+    auto ret = std::make_shared<const glyph_mask_t>(std::move(mask));
+    masks_.emplace(key, slot_t{ ret, lru_.begin(), fbudget().touch() });
+    trim_font_caches();
+    return ret;
+  }
+
+  // the most recent mask is never evictable, it is the one draw_text is about to blend
+  uint64_t oldest_use() const {
+    if(lru_.size() <= 1)
+      return font_cache_budget_t::never;
+    return masks_.at(lru_.back()).used;
+  }
+
+  void evict_oldest() {
+    auto it = masks_.find(lru_.back());
+    stats_.bytes -= it->second.mask->bytes();
+    stats_.items--;
+    stats_.evictions++;
+    masks_.erase(it);
+    lru_.pop_back();
+  }
+
+  const font_cache_stats_t &stats() const { return stats_; }
+
+  std::unordered_map<glyph_mask_key_t, slot_t, glyph_mask_key_hash_t> masks_;
+  std::list<glyph_mask_key_t> lru_;
+  font_cache_stats_t stats_;
+};
+
+inline glyph_mask_cache_t &gmasks() {
+  static glyph_mask_cache_t c;
+  return c;
+}
+
+inline void trim_font_caches() {
+  auto &ctx = fctx();
+  auto &masks = gmasks();
+  while(ctx.stats().bytes + masks.stats().bytes > fbudget().bytes_) {
+    uint64_t ent_used = ctx.oldest_use();
+    uint64_t mask_used = masks.oldest_use();
+    if(ent_used == font_cache_budget_t::never && mask_used == font_cache_budget_t::never)
+      break;
+    if(mask_used <= ent_used)
+      masks.evict_oldest();
+    else
+      ctx.evict_oldest();
+  }
+}
+
+// a glyph as resolved for a run, code is what the font actually draws (0 for a tofu)
+struct text_run_glyph_t {
+  font_token_t tok = 0;
+  uint32_t code = 0;
+  uint32_t txt_end = 0; // byte offset just past the codepoint it was decoded from
+  double advance_x = 0;
+};
+
+// a decoded, font-resolved and measured string
+struct text_run_t {
+  std::vector<text_run_glyph_t> glyphs;
+  double width = 0;
+};
+
+struct text_run_key_view_t {
+  std::string_view txt;
+  std::string_view sel;
+  unsigned height = 0;
+};
+
+struct text_run_key_t {
+  std::string txt;
+  std::string sel;
+  unsigned height = 0;
+
+  text_run_key_view_t view() const { return text_run_key_view_t{ txt, sel, height }; }
+};
+
+// ordered by view so lookups with a string_view never build a key
+struct text_run_key_less_t {
+  using is_transparent = void;
+
+  static bool less(const text_run_key_view_t &a, const text_run_key_view_t &b) {
+    if(a.height != b.height)
+      return a.height < b.height;
+    if(int c = a.sel.compare(b.sel))
+      return c < 0;
+    return a.txt < b.txt;
+  }
+
+  bool operator()(const text_run_key_t &a, const text_run_key_t &b) const { return less(a.view(), b.view()); }
+  bool operator()(const text_run_key_view_t &a, const text_run_key_t &b) const { return less(a, b.view()); }
+  bool operator()(const text_run_key_t &a, const text_run_key_view_t &b) const { return less(a.view(), b); }
+};
+
+// runs of bar strings, which are nearly all identical from frame to frame
+struct text_run_cache_t {
+  static constexpr std::size_t max_runs = 512;
+  // every entry is born with room for this many bytes of key and glyphs, so an evicted "1" can take over a clock
+  // string without growing
+  static constexpr std::size_t min_run_bytes = 16;
+
+  using run_ptr_t = std::shared_ptr<const text_run_t>;
+
+  struct slot_t {
+    std::shared_ptr<text_run_t> run;
+    std::list<text_run_key_view_t>::iterator lru;
+  };
+
+  run_ptr_t get(std::string_view txt, const std::string &sel, unsigned height) {
+    fmatcher().check_uptodate();
+    if(generation_ != fmatcher().generation_) {
+      runs_.clear();
+      lru_.clear();
+      generation_ = fmatcher().generation_;
+    }
+
+    text_run_key_view_t view{ txt, sel, height };
+    auto it = runs_.find(view);
+    if(it != runs_.end()) {
+      stats_.hits++;
+      lru_.splice(lru_.begin(), lru_, it->second.lru);
+      return it->second.run;
+    }
+    stats_.misses++;
+    if(runs_.size() < max_runs) {
+      auto run = std::make_shared<text_run_t>();
+      run->glyphs.reserve(std::max(min_run_bytes, txt.size()));
+      build(*run, txt, sel, height);
+      std::string key_txt;
+      key_txt.reserve(std::max(min_run_bytes, txt.size()));
+      key_txt.assign(txt);
+      it = runs_.emplace(text_run_key_t{ std::move(key_txt), sel, height }, slot_t{ std::move(run), {} }).first;
+      lru_.push_front(it->first.view());
+      it->second.lru = lru_.begin();
+      stats_.items = runs_.size();
+      return it->second.run;
+    }
+
+    // a full cache turns the oldest entry into the new one, its key strings, glyph vector and list node are reused
+    // so a bar cycling through fresh strings up to min_run_bytes long (the clock) stops reaching the heap
+    stats_.evictions++;
+    auto lru = std::prev(lru_.end());
+    auto node = runs_.extract(runs_.find(*lru));
+    node.key().txt.assign(txt);
+    node.key().sel.assign(sel);
+    node.key().height = height;
+    std::shared_ptr<text_run_t> &run = node.mapped().run;
+    // runs are only handed out under the font lock, so a sole owner here stays the sole owner
+    if(run.use_count() == 1)
+      std::atomic_thread_fence(std::memory_order_acquire);
+    else
+      run = std::make_shared<text_run_t>();
+    try {
+      build(*run, txt, sel, height);
+    } catch(...) {
+      lru_.erase(lru);
+      throw;
+    }
+    it = runs_.insert(std::move(node)).position;
+    *lru = it->first.view();
+    lru_.splice(lru_.begin(), lru_, lru);
+    it->second.lru = lru;
+    return it->second.run;
+  }
+
+  bool full() const noexcept { return runs_.size() >= max_runs; }
+
+  static void build(text_run_t &run, std::string_view txt, const std::string &sel, unsigned height) {
+    run.glyphs.clear();
+    run.width = 0;
+    fctx().select(sel);
+    fctx().height(height);
+    std::size_t txt_size = txt.size();
+    while(txt.size()) {
+      int32_t codepoint = 0;
+      ssize_t sz = utf8proc_iterate(reinterpret_cast<const uint8_t *>(txt.data()), txt.size(), &codepoint);
+      if(sz < 0) {
+        // attempt to skip over garbage and resume
+        sz = 1;
+        codepoint = 0; // draw a tofu
+      }
+      txt.remove_prefix(sz);
+
+      const agg::glyph_cache *glyph = fctx().glyph(codepoint);
+      if(glyph && glyph->data_type != agg::glyph_data_outline && codepoint != 0)
+        glyph = fctx().glyph(0);
+      if(!glyph || glyph->data_type != agg::glyph_data_outline)
+        ytk::raise("fonts installed too broken to even draw a tofu");
+      run.glyphs.push_back(text_run_glyph_t{ fctx().curr_tok_, static_cast<uint32_t>(fctx().curr_code_), static_cast<uint32_t>(txt_size - txt.size()), glyph->advance_x });
+      run.width += glyph->advance_x;
+    }
+  }
+
+  const font_cache_stats_t &stats() const { return stats_; }
+
+  // keys in lru_ view the strings owned by runs_ keys, which std::map never moves
+  std::map<text_run_key_t, slot_t, text_run_key_less_t> runs_;
+  std::list<text_run_key_view_t> lru_;
+  uint64_t generation_ = 0;
+  font_cache_stats_t stats_;
+};
+
+inline text_run_cache_t &fruns() {
+  static text_run_cache_t c;
+  return c;
+}
+
+}
@@ -1,10 +1,7 @@
 #pragma once
 
 #include "agg_basics.h"
-#include "agg_conv_contour.h"
-#include "agg_conv_curve.h"
-#include "agg_font_cache_manager.h"
-#include "agg_font_freetype.h"
+#include "agg_path_storage.h"
 #include "agg_rasterizer_scanline_aa.h"
 #include "agg_renderer_scanline.h"
 #include "agg_rendering_buffer.h"
@@ -17,271 +14,143 @@
 #include "agg_span_interpolator_trans.h"
 #include "agg_trans_perspective.h"
 
+#include "bar/gc/backdrop.hpp"
 #include "bar/gc/colorscheme.hpp"
+#include "bar/gc/font.hpp"
+#include "bar/gc/rect.hpp"
+#include "bar/gc/style.hpp"
 #include "bar/layout/zone.hpp"
-#include "utf8proc.h"
 #include "ytk/misc/common.hpp"
 
-#include "fontconfig/fontconfig.h"
-
-#include "bar/gc/colors/kanagawa.hpp"
+#include <cmath>
 #include <cstdint>
+#include <cstring>
 #include <map>
 #include <memory>
+#include <mutex>
 #include <sstream>
+#include <type_traits>
 
 namespace bar {
 
-enum class panel_flavor_t { none, datetime, logo, tagsel, tagsel_active, winsel, winsel_active, volume, im, tagsel_occ, tagsel_urg, winsel_hidden, ltbutton };
-
 enum class ltbutton_icon_t { floating, monocle, tiled };
 
-using font_token_t = uint32_t;
-
-struct font_matcher_t {
-  font_matcher_t() { conf_ = FcInitLoadConfigAndFonts(); }
-
-  font_token_t get_or_create_token(const std::string &path) {
-    auto it = file_to_token_.find(path);
-    if(it == file_to_token_.end()) {
-      font_token_t tok = next_token_++;
-      file_to_token_.emplace(path, tok);
-      token_to_file_.emplace(tok, path);
-      return tok;
-    }
-    return it->second;
+// coverage of a run glyph. on a cache miss the outline is copied out under font_mutex and rasterized without it, so
+// workers missing different glyphs do not queue behind each other. outline, ras and sl are scratch
+template <class Ras, class Sl>
+std::shared_ptr<const glyph_mask_t> glyph_mask(agg::path_storage &outline, Ras &ras, Sl &sl, const text_run_glyph_t &glyph, unsigned height,
+                                               unsigned subpx) {
+  glyph_mask_key_t key{ glyph.tok, height, glyph.code, subpx };
+  {
+    std::lock_guard<std::mutex> lock{ font_mutex() };
+    if(auto cached = gmasks().find(key))
+      return cached;
+    fctx().height(height);
+    if(!fctx().glyph_from(glyph.tok, glyph.code))
+      ytk::raise("glyph {} vanished from font {}", glyph.code, glyph.tok);
+    outline.remove_all();
+    outline.concat_path(fctx().vertex_source(static_cast<double>(subpx) / glyph_subpixel_steps, 0));
   }
 
-  const std::string &get_path(font_token_t tok) const { return token_to_file_.at(tok); }
-
-  std::vector<font_token_t> match_fonts(const std::string &sel) {
-    std::vector<font_token_t> tokens;
-
-    FcResult result;
-    FcPattern *pat = FcNameParse(reinterpret_cast<const FcChar8 *>(sel.c_str()));
-    if(!pat)
-      ytk::raise("FcNameParse(\"{}\") failed", sel);
-
-    FcConfigSubstitute(conf_, pat, FcMatchPattern);
-    FcDefaultSubstitute(pat);
-
-    FcFontSet *fs = FcFontSort(conf_, pat, FcTrue, 0, &result);
-    if(fs) {
-      for(unsigned i = 0; i < fs->nfont; i++) {
-        FcValue v;
-        FcPatternGet(fs->fonts[i], FC_FILE, 0, &v);
-        std::string path{ reinterpret_cast<const char *>(v.u.f) };
-        tokens.push_back(get_or_create_token(path));
+  glyph_mask_t mask;
+  ras.reset();
+  ras.add_path(outline);
+  if(ras.rewind_scanlines()) {
+    mask.x = ras.min_x();
+    mask.y = ras.min_y();
+    mask.w = ras.max_x() - ras.min_x() + 1;
+    mask.h = ras.max_y() - ras.min_y() + 1;
+    mask.covers.resize(mask.w * mask.h);
+    sl.reset(ras.min_x(), ras.max_x());
+    while(ras.sweep_scanline(sl)) {
+      agg::int8u *row = mask.covers.data() + (sl.y() - mask.y) * mask.w;
+      unsigned num_spans = sl.num_spans();
+      auto span = sl.begin();
+      for(;;) {
+        std::memcpy(row + (span->x - mask.x), span->covers, span->len);
+        if(--num_spans == 0)
+          break;
+        ++span;
       }
-      FcFontSetSortDestroy(fs);
     }
-    FcPatternDestroy(pat);
-    return tokens;
   }
-
-  FcConfig *conf_ = nullptr;
-  font_token_t next_token_ = 1;
-  std::map<std::string, font_token_t> file_to_token_;
-  std::map<font_token_t, std::string> token_to_file_;
-};
-
-inline font_matcher_t &fmatcher() {
-  static font_matcher_t m;
-  return m;
+  std::lock_guard<std::mutex> lock{ font_mutex() };
+  return gmasks().insert(key, std::move(mask));
 }
 
-struct agg_font_entry_t {
-  typedef agg::font_engine_freetype_int32 font_engine_type;
-  typedef agg::font_cache_manager<font_engine_type> font_manager_type;
-
-  explicit agg_font_entry_t(const std::string &path) {
-    if(!feng_.load_font(path.c_str(), 0, agg::glyph_ren_outline)) {
-      ytk::raise("font file not found : {}", path);
-    }
-    feng_.height(50);
-    curves_.approximation_scale(2.0);
-    contour_.auto_detect_orientation(false);
-    contour_.width(0.5);
-    feng_.flip_y(true);
+// zone level drawing shared by every gc, Derived provides the primitives in absolute coordinates
+template <class Derived> struct zone_draw_t {
+  void draw_text(std::string_view txt, const zone_t &z, const zone_attr_t &attr, panel_flavor_t flavor = panel_flavor_t::none) {
+    double margin = attr.margin_ratio * z.h;
+    self().draw_text(txt, z.x + margin, z.y + z.h * attr.bl_ratio, z.w - margin * 2, z.h * attr.txth_ratio, flavor);
   }
 
-  void height(unsigned px) { feng_.height(px); }
-
-  const auto *glyph(uint_least32_t code) { return curr_glyph_ = fman_.glyph(code); }
-
-  auto &vertex_source(double x, double y) {
-    fman_.init_embedded_adaptors(curr_glyph_, x, y);
-    return contour_;
+  void draw_volbar(double rate, const zone_t &z, const zone_attr_t &attr, panel_flavor_t flavor = panel_flavor_t::none) {
+    double margin = attr.margin_ratio * z.h;
+    self().draw_volbar(rate, z.x + margin, z.y + z.h * (1.0 - attr.volbar_ratio) / 2, z.w - margin * 2, z.h * attr.volbar_ratio, flavor);
   }
 
-  font_engine_type feng_;
-  font_manager_type fman_{ feng_ };
-  const agg::glyph_cache *curr_glyph_ = nullptr;
-  agg::conv_curve<font_manager_type::path_adaptor_type> curves_{ fman_.path_adaptor() };
-  agg::conv_contour<agg::conv_curve<font_manager_type::path_adaptor_type>> contour_{ curves_ };
-};
-
-struct agg_font_context_t {
-  void select(const std::string &sel) { curr_sel_ = fmatcher().match_fonts(sel); }
+  void draw_ltbutton_icon(ltbutton_icon_t icon, const zone_t &z, const zone_attr_t &attr, panel_flavor_t flavor = panel_flavor_t::none) {
+    double margin = attr.margin_ratio * z.h;
+    self().draw_ltbutton_icon(icon, z.x + margin, z.y + margin, z.w - margin * 2, z.h - (2 * margin), flavor);
+  }
 
-  void height(unsigned px) { curr_height_ = px; }
+  void draw_panel_bg(const zone_t &z, panel_flavor_t flavor = panel_flavor_t::none) { self().draw_panel_bg(z.x, z.y, z.w, z.h, flavor); }
 
-  agg_font_entry_t &get_or_create_entry(font_token_t tok) {
-    auto it = entries_.find(tok);
-    if(it == entries_.end()) {
-      it = entries_.emplace(tok, std::make_unique<agg_font_entry_t>(fmatcher().get_path(tok))).first;
-    }
-    return *it->second;
+  void draw_text_panel(std::string_view txt, const zone_t &z, const zone_attr_t &attr, panel_flavor_t flavor = panel_flavor_t::none) {
+    draw_panel_bg(z, flavor);
+    draw_text(txt, z, attr, flavor);
   }
 
-  const agg::glyph_cache *glyph(uint_least32_t code) {
-    for(auto it : curr_sel_) {
-      auto &ent = get_or_create_entry(it);
-      auto *glyph_ptr = ent.glyph(code);
-      if(glyph_ptr) {
-        ent.height(curr_height_);
-        glyph_ptr = ent.glyph(code);
-        curr_ent_ = &ent;
-        return glyph_ptr;
-      }
-    }
-    if(code == 0)
-      return nullptr;
-    return glyph(0);
+  void draw_volbar_panel(double rate, const zone_t &z, const zone_attr_t &attr, panel_flavor_t flavor = panel_flavor_t::none) {
+    draw_panel_bg(z, flavor);
+    draw_volbar(rate, z, attr, flavor);
   }
 
-  auto &vertex_source(double x, double y) { return curr_ent_->vertex_source(x, y); }
+  void draw_panel_pin(const zone_t &z, panel_flavor_t flavor = panel_flavor_t::none) { self().draw_panel_pin(z.x, z.y, z.h * 0.35, flavor); }
 
-  std::vector<font_token_t> curr_sel_;
-  agg_font_entry_t *curr_ent_ = nullptr;
-  unsigned curr_height_ = 50;
-  std::map<font_token_t, std::unique_ptr<agg_font_entry_t>> entries_;
+private:
+  Derived &self() { return static_cast<Derived &>(*this); }
 };
 
-inline agg_font_context_t &fctx() {
-  static agg_font_context_t ctx;
-  return ctx;
-}
-
-template <class PixFmt> struct agg_gc_t {
-  explicit agg_gc_t(PixFmt &pixfmt) : pixfmt_(&pixfmt), ren_(pixfmt), ren_solid_(ren_) {}
-
-  static auto conv(rgb_literal_t lit) { return as_color<agg::rgba8>(lit); }
-
-  static auto conv(rgb_literal_t lit, uint8_t a) { return as_color<agg::rgba8>(lit, a); }
-
-  static auto panel_bg_color(panel_flavor_t flavor) {
-    switch(flavor) {
-    case panel_flavor_t::datetime:
-      return conv(colors::kanagawa::waveBlue1);
-    case panel_flavor_t::logo:
-      return conv(colors::kanagawa::sumiInk1);
-    case panel_flavor_t::tagsel:
-      return conv(colors::kanagawa::waveBlue1, 204);
-    case panel_flavor_t::tagsel_active:
-      return conv(colors::kanagawa::waveBlue2);
-    case panel_flavor_t::ltbutton:
-      return conv(colors::kanagawa::winterBlue);
-    case panel_flavor_t::winsel_active:
-      return conv(colors::kanagawa::fujiWhite);
-    case panel_flavor_t::im:
-      return conv(colors::kanagawa::winterBlue);
-    case panel_flavor_t::volume:
-      return conv(colors::kanagawa::sumiInk3);
-    case panel_flavor_t::none:   // fallthrough
-    case panel_flavor_t::winsel: // fallthrough
-    default:
-      return conv(colors::kanagawa::sumiInk3, 204);
-    }
-  }
+template <class PixFmt> struct agg_gc_t : zone_draw_t<agg_gc_t<PixFmt>> {
+  using zone_api = zone_draw_t<agg_gc_t<PixFmt>>;
+  using zone_api::draw_ltbutton_icon;
+  using zone_api::draw_panel_bg;
+  using zone_api::draw_panel_pin;
+  using zone_api::draw_text;
+  using zone_api::draw_volbar;
 
-  static auto panel_pin_color(panel_flavor_t flavor) {
-    switch(flavor) {
-    case panel_flavor_t::tagsel_urg:
-      return conv(colors::kanagawa::peachRed);
-    case panel_flavor_t::tagsel_occ:
-      return conv(colors::kanagawa::fujiWhite);
-    case panel_flavor_t::winsel_hidden:
-      return conv(colors::kanagawa::katanaGray);
-    default:
-      return conv(colors::kanagawa::winterBlue);
-    }
-  }
+  explicit agg_gc_t(PixFmt &pixfmt) : pixfmt_(&pixfmt), ren_(pixfmt) {}
 
-  static auto volbar_plate_color(panel_flavor_t) { return conv(colors::kanagawa::fujiGray); }
-
-  static auto panel_fg_color(panel_flavor_t flavor) {
-    switch(flavor) {
-    case panel_flavor_t::datetime:
-      return conv(colors::kanagawa::springBlue);
-    case panel_flavor_t::logo:
-      return conv(colors::kanagawa::springViolet1);
-    case panel_flavor_t::winsel_active:
-      return conv(colors::kanagawa::waveBlue2);
-    case panel_flavor_t::tagsel:
-      return conv(colors::kanagawa::surimiOrange);
-    case panel_flavor_t::tagsel_active:
-      return conv(colors::kanagawa::surimiOrange);
-    case panel_flavor_t::ltbutton: // fallthrough
-    case panel_flavor_t::none:     // fallthrough
-    default:
-      return conv(colors::kanagawa::fujiWhite);
+  // axis aligned rectangles go through the span compositor when the pixel format allows it
+  void fill_rect(double x1, double y1, double x2, double y2, const agg::rgba8 &color) {
+    if constexpr(rect_pixfmt_v<PixFmt>) {
+      rect_fill(ren_, x1, y1, x2, y2, color);
+    } else {
+      ras_.reset();
+      ras_.move_to_d(x1, y1);
+      ras_.line_to_d(x2, y1);
+      ras_.line_to_d(x2, y2);
+      ras_.line_to_d(x1, y2);
+      agg::render_scanlines_aa_solid(ras_, sl_, ren_, color);
     }
   }
 
-  static std::string panel_font_selector(panel_flavor_t flavor) {
-    // return "deja vu sans mono";
-    return "monospace";
-  }
-
   void draw_volbar(double rate, double x, double y, double w, double h, panel_flavor_t flavor = panel_flavor_t::none) {
-    ras_.reset();
-    ras_.move_to_d(x, y);
-    ras_.line_to_d(x + w, y);
-    ras_.line_to_d(x + w, y + h);
-    ras_.line_to_d(x, y + h);
-    agg::render_scanlines_aa_solid(ras_, sl_, ren_, volbar_plate_color(flavor));
-
-    ras_.reset();
-    ras_.move_to_d(x, y);
-    ras_.line_to_d(x + (w * rate), y);
-    ras_.line_to_d(x + (w * rate), y + h);
-    ras_.line_to_d(x, y + h);
-    agg::render_scanlines_aa_solid(ras_, sl_, ren_, panel_fg_color(flavor));
+    fill_rect(x, y, x + w, y + h, pstyles()[flavor].volbar_plate);
+    fill_rect(x, y, x + (w * rate), y + h, pstyles()[flavor].fg);
   }
 
   void draw_ltbutton_icon(ltbutton_icon_t icon, double x, double y, double w, double h, panel_flavor_t flavor = panel_flavor_t::none) {
     ras_.reset();
     switch(icon) {
     case ltbutton_icon_t::monocle:
-      ras_.move_to_d(x, y);
-      ras_.line_to_d(x + w, y);
-      ras_.line_to_d(x + w, y + h);
-      ras_.line_to_d(x, y + h);
-      ras_.close_polygon();
+      fill_rect(x, y, x + w, y + h, pstyles()[flavor].fg);
+      return;
+    case ltbutton_icon_t::floating:
+      add_floating_icon(x, y, w, h);
       break;
-    case ltbutton_icon_t::floating: {
-      double x1 = x + (w / 3);
-      double x2 = x + (w / 3) * 2;
-      double x3 = x + w;
-      double y1 = y + (h / 3);
-      double y2 = y + (h / 3) * 2;
-      double y3 = y + h;
-      ras_.move_to_d(x, y1);
-      ras_.line_to_d(x, y3);
-      ras_.line_to_d(x2, y3);
-      ras_.line_to_d(x2, y2);
-      ras_.line_to_d(x1, y2);
-      ras_.line_to_d(x1, y1);
-      ras_.close_polygon();
-      ras_.move_to_d(x1, y1);
-      ras_.line_to_d(x2, y1);
-      ras_.line_to_d(x2, y2);
-      ras_.line_to_d(x3, y2);
-      ras_.line_to_d(x3, y);
-      ras_.line_to_d(x1, y);
-      ras_.close_polygon();
-    } break;
     default: {
       double x1 = x + w * 0.45;
       double x2 = x + w * 0.55;
@@ -289,166 +158,160 @@ template <class PixFmt> struct agg_gc_t {
       double y1 = y + h * 0.45;
       double y2 = y + h * 0.55;
       double y3 = y + h;
-      ras_.move_to_d(x, y);
-      ras_.line_to_d(x, y3);
-      ras_.line_to_d(x1, y3);
-      ras_.line_to_d(x1, y);
-      ras_.close_polygon();
-      ras_.move_to_d(x2, y);
-      ras_.line_to_d(x2, y1);
-      ras_.line_to_d(x3, y1);
-      ras_.line_to_d(x3, y);
-      ras_.close_polygon();
-      ras_.move_to_d(x2, y2);
-      ras_.line_to_d(x2, y3);
-      ras_.line_to_d(x3, y3);
-      ras_.line_to_d(x3, y2);
-      ras_.close_polygon();
-    } break;
+      fill_rect(x, y, x1, y3, pstyles()[flavor].fg);
+      fill_rect(x2, y, x3, y1, pstyles()[flavor].fg);
+      fill_rect(x2, y2, x3, y3, pstyles()[flavor].fg);
+      return;
+    }
     }
-    agg::render_scanlines_aa_solid(ras_, sl_, ren_, panel_fg_color(flavor));
+    fill_paths(pstyles()[flavor].fg);
+  }
+
+  // the two L shapes share edges, rasterizing them together keeps the seams closed
+  void add_floating_icon(double x, double y, double w, double h) {
+    double x1 = x + (w / 3);
+    double x2 = x + (w / 3) * 2;
+    double x3 = x + w;
+    double y1 = y + (h / 3);
+    double y2 = y + (h / 3) * 2;
+    double y3 = y + h;
+    ras_.move_to_d(x, y1);
+    ras_.line_to_d(x, y3);
+    ras_.line_to_d(x2, y3);
+    ras_.line_to_d(x2, y2);
+    ras_.line_to_d(x1, y2);
+    ras_.line_to_d(x1, y1);
+    ras_.close_polygon();
+    ras_.move_to_d(x1, y1);
+    ras_.line_to_d(x2, y1);
+    ras_.line_to_d(x2, y2);
+    ras_.line_to_d(x3, y2);
+    ras_.line_to_d(x3, y);
+    ras_.line_to_d(x1, y);
+    ras_.close_polygon();
   }
 
   void draw_panel_bg(double x, double y, double w, double h, panel_flavor_t flavor = panel_flavor_t::none) {
-    ras_.reset();
-    ras_.move_to_d(x, y);
-    ras_.line_to_d(x + w, y);
-    ras_.line_to_d(x + w, y + h);
-    ras_.line_to_d(x, y + h);
-    agg::render_scanlines_aa_solid(ras_, sl_, ren_, panel_bg_color(flavor));
+    fill_rect(x, y, x + w, y + h, pstyles()[flavor].bg);
   }
 
   void draw_panel_pin(double x, double y, double a, panel_flavor_t flavor = panel_flavor_t::none) {
     ras_.reset();
+    add_panel_pin(x, y, a);
+    fill_paths(pstyles()[flavor].pin);
+  }
+
+  void add_panel_pin(double x, double y, double a) {
     ras_.move_to_d(x, y);
     ras_.line_to_d(x + a, y);
     ras_.line_to_d(x, y + a);
-    agg::render_scanlines_aa_solid(ras_, sl_, ren_, panel_pin_color(flavor));
+    ras_.close_polygon();
   }
 
-  void draw_text(std::string_view txt, double x, double bl_y, double w, double h, panel_flavor_t flavor = panel_flavor_t::none) {
-    std::vector<uint32_t> codepoints;
-    while(txt.size()) {
-      int32_t codepoint = 0;
-      ssize_t sz = utf8proc_iterate(reinterpret_cast<const uint8_t *>(txt.data()), txt.size(), &codepoint);
-      if(sz < 0) {
-        // attempt to skip over garbage and resume
-        txt.remove_prefix(1);
-        codepoint = 0; // draw a tofu
-      }
-      txt.remove_prefix(sz);
-      codepoints.emplace_back(codepoint);
-    }
+  void begin_paths() { ras_.reset(); }
 
-    fctx().select(panel_font_selector(flavor));
-    fctx().height(h);
-    double x_max = x + w;
+  // renders every path added since the last reset in one pass
+  void fill_paths(const agg::rgba8 &color) {
+    agg::render_scanlines_aa_solid(ras_, sl_, ren_, color);
+    ras_.reset();
+  }
 
-    double txt_w = 0;
-    for(const uint32_t &codepoint : codepoints) {
-      const agg::glyph_cache *glyph = fctx().glyph(codepoint);
-      if(!glyph)
-        ytk::raise("fonts installed too broken to even draw a tofu");
-      txt_w += glyph->advance_x;
+  // a text wider than w is drawn up to the first glyph starting past its end and faded out, so only that prefix is
+  // ever rasterized
+  void draw_text(std::string_view txt, double x, double bl_y, double w, double h, panel_flavor_t flavor = panel_flavor_t::none) {
+    panel_style_t &style = pstyles()[flavor];
+    unsigned height = static_cast<unsigned>(h);
+    std::shared_ptr<const text_run_t> run_ptr;
+    {
+      std::lock_guard<std::mutex> lock{ font_mutex() };
+      run_ptr = fruns().get(txt, style.font, height);
     }
+    const text_run_t &run = *run_ptr;
+    double x_max = x + w;
+    bool fade_out = run.width > w;
 
-    bool fade_out = false;
-    if(txt_w <= w) {
-      x += (w - txt_w) / 2;
-    } else {
-      fade_out = true;
-    }
+    if(!fade_out)
+      x += (w - run.width) / 2;
 
     using color_type = typename PixFmt::color_type;
     using span_interpolator_type = agg::span_interpolator_linear<>;
-    using color_func_type = agg::gradient_lut<agg::color_interpolator<color_type>, 256>;
     using gradient_type = agg::gradient_x;
+    static_assert(std::is_same_v<color_type, agg::rgba8>, "fade luts are prebuilt for rgba8");
 
     agg::trans_affine trans;
     trans.translate(x, 0);
     trans.invert();
 
     gradient_type gr;
-    agg::span_allocator<color_type> span_alloc;
     span_interpolator_type inter{ trans };
-    color_func_type colors;
-
-    auto color = panel_fg_color(flavor);
-    auto color_fade = color;
-    color_fade.a = 0;
-    colors.add_color(0.0, color);
-    colors.add_color(0.8, color);
-    colors.add_color(1.0, color_fade);
-    colors.build_lut();
-    agg::span_gradient<color_type, span_interpolator_type, gradient_type, color_func_type> span_gen{ inter, gr, colors, 0, w };
-
-    if(!fade_out) {
-      ren_solid_.color(color);
-    }
-
-    for(auto codepoint : codepoints) {
-    __reenter:
-      const agg::glyph_cache *glyph = fctx().glyph(codepoint);
-
-      switch(glyph->data_type) {
-      case agg::glyph_data_outline:
-        ras_.reset();
-        ras_.add_path(fctx().vertex_source(x, bl_y));
+    agg::span_gradient<color_type, span_interpolator_type, gradient_type, fade_lut_t> span_gen{ inter, gr, style.fade, 0, w };
+
+    int bl_yi = static_cast<int>(std::lround(bl_y));
+
+    for(const text_run_glyph_t &glyph : run.glyphs) {
+      if(fade_out && x > x_max)
+        return;
+      double x_floor = std::floor(x);
+      int xi = static_cast<int>(x_floor);
+      unsigned subpx = static_cast<unsigned>(std::lround((x - x_floor) * glyph_subpixel_steps));
+      if(subpx == glyph_subpixel_steps) {
+        xi++;
+        subpx = 0;
+      }
+      auto mask_ptr = glyph_mask(glyph, height, subpx);
+      const glyph_mask_t &mask = *mask_ptr;
+      for(unsigned r = 0; r < mask.h; r++) {
+        int span_x = xi + mask.x;
+        int span_y = bl_yi + mask.y + static_cast<int>(r);
         if(fade_out) {
-          if(x > x_max)
-            return;
-          agg::render_scanlines_aa(ras_, sl_, ren_, span_alloc, span_gen);
+          color_type *span = span_alloc_.allocate(mask.w);
+          span_gen.generate(span, span_x, span_y, mask.w);
+          ren_.blend_color_hspan(span_x, span_y, mask.w, span, mask.row(r));
         } else {
-          agg::render_scanlines(ras_, sl_, ren_solid_);
-        }
-        break;
-      default:
-        if(codepoint != 0) {
-          codepoint = 0;
-          goto __reenter;
+          ren_.blend_solid_hspan(span_x, span_y, mask.w, style.fg, mask.row(r));
         }
-        ytk::raise("fonts installed too broken to even draw a tofu");
       }
-
-    __move_on:
-      x += glyph->advance_x;
+      x += glyph.advance_x;
     }
   }
 
-  void draw_text(const std::string &txt, const zone_t &z, const zone_attr_t &attr, panel_flavor_t flavor = panel_flavor_t::none) {
-    double margin = attr.margin_ratio * z.h;
-    draw_text(txt, z.x + margin, z.y + z.h * attr.bl_ratio, z.w - margin * 2, z.h * attr.txth_ratio, flavor);
-  }
-
-  void draw_volbar(double rate, const zone_t &z, const zone_attr_t &attr, panel_flavor_t flavor = panel_flavor_t::none) {
-    double margin = attr.margin_ratio * z.h;
-    draw_volbar(rate, z.x + margin, z.y + z.h * (1.0 - attr.volbar_ratio) / 2, z.w - margin * 2, z.h * attr.volbar_ratio, flavor);
-  }
-
-  void draw_ltbutton_icon(ltbutton_icon_t icon, const zone_t &z, const zone_attr_t &attr, panel_flavor_t flavor = panel_flavor_t::none) {
-    double margin = attr.margin_ratio * z.h;
-    draw_ltbutton_icon(icon, z.x + margin, z.y + margin, z.w - margin * 2, z.h - (2 * margin));
+  std::shared_ptr<const glyph_mask_t> glyph_mask(const text_run_glyph_t &glyph, unsigned height, unsigned subpx) {
+    return bar::glyph_mask(outline_, ras_, sl_, glyph, height, subpx);
   }
 
-  void draw_panel_bg(const zone_t &z, panel_flavor_t flavor = panel_flavor_t::none) { draw_panel_bg(z.x, z.y, z.w, z.h, flavor); }
-
-  void draw_text_panel(const std::string &txt, const zone_t &z, const zone_attr_t &attr, panel_flavor_t flavor = panel_flavor_t::none) {
-    draw_panel_bg(z, flavor);
-    draw_text(txt, z, attr, flavor);
+  // clears a pixel aligned zone and confines drawing to it until end_zone()
+  void begin_zone(const zone_t &z) {
+    int x1 = static_cast<int>(std::lround(z.x));
+    int y1 = static_cast<int>(std::lround(z.y));
+    int x2 = static_cast<int>(std::lround(z.x + z.w)) - 1;
+    int y2 = static_cast<int>(std::lround(z.y + z.h)) - 1;
+    ren_.reset_clipping(true);
+    ren_.copy_bar(x1, y1, x2, y2, typename PixFmt::color_type(0, 0, 0, 0));
+    ren_.clip_box(x1, y1, x2, y2);
   }
 
-  void draw_volbar_panel(double rate, const zone_t &z, const zone_attr_t &attr, panel_flavor_t flavor = panel_flavor_t::none) {
-    draw_panel_bg(z, flavor);
-    draw_volbar(rate, z, attr, flavor);
+  // like begin_zone(z), but the zone starts out as the same pixels of a backdrop laid over the whole target
+  void begin_zone(const zone_t &z, const backdrop_t &drop) {
+    int x1 = static_cast<int>(std::lround(z.x));
+    int y1 = static_cast<int>(std::lround(z.y));
+    int x2 = static_cast<int>(std::lround(z.x + z.w)) - 1;
+    int y2 = static_cast<int>(std::lround(z.y + z.h)) - 1;
+    if(drop.empty() || x2 >= static_cast<int>(drop.w) || y2 >= static_cast<int>(drop.h))
+      return begin_zone(z);
+    ren_.reset_clipping(true);
+    ren_.clip_box(x1, y1, x2, y2);
+    agg::rect_i r{ x1, y1, x2, y2 };
+    ren_.copy_from(drop.rbuf(), &r);
   }
 
-  void draw_panel_pin(const zone_t &z, panel_flavor_t flavor = panel_flavor_t::none) { draw_panel_pin(z.x, z.y, z.h * 0.35, flavor); }
+  void end_zone() { ren_.reset_clipping(true); }
 
   PixFmt *pixfmt_;
   agg::renderer_base<PixFmt> ren_;
-  agg::renderer_scanline_aa_solid<agg::renderer_base<PixFmt>> ren_solid_;
+  agg::path_storage outline_;
   agg::rasterizer_scanline_aa<> ras_;
   agg::scanline_u8 sl_;
+  agg::span_allocator<typename PixFmt::color_type> span_alloc_;
 };
 
 }
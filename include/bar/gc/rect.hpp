@@ -0,0 +1,149 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+#include "agg_color_rgba.h"
+#include "agg_pixfmt_rgb.h"
+#include "agg_pixfmt_rgba.h"
+#include "agg_renderer_base.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define BAR_RECT_X86 1
+#endif
+
+namespace bar {
+
+// 4 byte pixels laid out b, g, r, a|x, premultiplied bgra on the 32 bit visual and plain bgrx on 24 bit
+template <class PixFmt>
+inline constexpr bool rect_pixfmt_v = std::is_same_v<PixFmt, agg::pixfmt_bgra32> || std::is_same_v<PixFmt, agg::pixfmt_bgrx32>;
+
+// a solid source pixel, premultiplied and already scaled by coverage
+struct rect_src_t {
+  uint32_t pix = 0;
+  uint8_t a = 0;
+};
+
+inline unsigned rect_div255(unsigned v) {
+  v += 128;
+  return (v + (v >> 8)) >> 8;
+}
+
+inline rect_src_t rect_src(const agg::rgba8 &c, unsigned cover) {
+  unsigned a = rect_div255(c.a * cover);
+  rect_src_t s;
+  s.pix = rect_div255(c.b * a) | (rect_div255(c.g * a) << 8) | (rect_div255(c.r * a) << 16) | (a << 24);
+  s.a = static_cast<uint8_t>(a);
+  return s;
+}
+
+inline void rect_blend_scalar(uint8_t *p, unsigned n, rect_src_t s) {
+  unsigned ia = 255 - s.a;
+  for(; n; n--, p += 4) {
+    p[0] = static_cast<uint8_t>((s.pix & 0xff) + rect_div255(p[0] * ia));
+    p[1] = static_cast<uint8_t>(((s.pix >> 8) & 0xff) + rect_div255(p[1] * ia));
+    p[2] = static_cast<uint8_t>(((s.pix >> 16) & 0xff) + rect_div255(p[2] * ia));
+    p[3] = static_cast<uint8_t>((s.pix >> 24) + rect_div255(p[3] * ia));
+  }
+}
+
+#ifdef BAR_RECT_X86
+
+// dst = src + dst * (255 - a) / 255 on every channel, four pixels at a time
+__attribute__((target("sse2"))) inline void rect_blend_sse2(uint8_t *p, unsigned n, rect_src_t s) {
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i src = _mm_set1_epi32(static_cast<int>(s.pix));
+  const __m128i ia = _mm_set1_epi16(static_cast<short>(255 - s.a));
+  const __m128i half = _mm_set1_epi16(128);
+  for(; n >= 4; n -= 4, p += 16) {
+    __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+    __m128i lo = _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(d, zero), ia), half);
+    __m128i hi = _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(d, zero), ia), half);
+    lo = _mm_srli_epi16(_mm_add_epi16(lo, _mm_srli_epi16(lo, 8)), 8);
+    hi = _mm_srli_epi16(_mm_add_epi16(hi, _mm_srli_epi16(hi, 8)), 8);
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(p), _mm_adds_epu8(_mm_packus_epi16(lo, hi), src));
+  }
+  rect_blend_scalar(p, n, s);
+}
+
+__attribute__((target("avx2"))) inline void rect_blend_avx2(uint8_t *p, unsigned n, rect_src_t s) {
+  const __m256i zero = _mm256_setzero_si256();
+  const __m256i src = _mm256_set1_epi32(static_cast<int>(s.pix));
+  const __m256i ia = _mm256_set1_epi16(static_cast<short>(255 - s.a));
+  const __m256i half = _mm256_set1_epi16(128);
+  for(; n >= 8; n -= 8, p += 32) {
+    __m256i d = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+    __m256i lo = _mm256_add_epi16(_mm256_mullo_epi16(_mm256_unpacklo_epi8(d, zero), ia), half);
+    __m256i hi = _mm256_add_epi16(_mm256_mullo_epi16(_mm256_unpackhi_epi8(d, zero), ia), half);
+    lo = _mm256_srli_epi16(_mm256_add_epi16(lo, _mm256_srli_epi16(lo, 8)), 8);
+    hi = _mm256_srli_epi16(_mm256_add_epi16(hi, _mm256_srli_epi16(hi, 8)), 8);
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(p), _mm256_adds_epu8(_mm256_packus_epi16(lo, hi), src));
+  }
+  rect_blend_sse2(p, n, s);
+}
+
+#endif
+
+// composites a solid source over n pixels, opaque sources turn into a plain fill
+inline void rect_blend_span(uint8_t *p, unsigned n, rect_src_t s) {
+  if(s.a == 0 || n == 0)
+    return;
+  if(s.a == 255) {
+    std::fill_n(reinterpret_cast<uint32_t *>(p), n, s.pix);
+    return;
+  }
+#ifdef BAR_RECT_X86
+  static const bool has_avx2 = __builtin_cpu_supports("avx2");
+  static const bool has_sse2 = __builtin_cpu_supports("sse2");
+  if(has_avx2)
+    return rect_blend_avx2(p, n, s);
+  if(has_sse2)
+    return rect_blend_sse2(p, n, s);
+#endif
+  rect_blend_scalar(p, n, s);
+}
+
+// fills [x1, x2) x [y1, y2) inside the renderer's clip box, coverage is the exact pixel area like the aa rasterizer
+template <class PixFmt> void rect_fill(agg::renderer_base<PixFmt> &ren, double x1, double y1, double x2, double y2, const agg::rgba8 &c) {
+  static_assert(rect_pixfmt_v<PixFmt>);
+  if(x1 > x2)
+    std::swap(x1, x2);
+  if(y1 > y2)
+    std::swap(y1, y2);
+  x1 = std::max(x1, static_cast<double>(ren.xmin()));
+  y1 = std::max(y1, static_cast<double>(ren.ymin()));
+  x2 = std::min(x2, static_cast<double>(ren.xmax() + 1));
+  y2 = std::min(y2, static_cast<double>(ren.ymax() + 1));
+  if(x1 >= x2 || y1 >= y2 || c.a == 0)
+    return;
+
+  int ix1 = static_cast<int>(std::floor(x1));
+  int ix2 = static_cast<int>(std::ceil(x2));
+  int iy1 = static_cast<int>(std::floor(y1));
+  int iy2 = static_cast<int>(std::ceil(y2));
+
+  // left and right partial columns, a rect narrower than a pixel is all one column
+  double lcov = std::min(x2, ix1 + 1.0) - x1;
+  double rcov = ix2 - 1 > ix1 ? x2 - (ix2 - 1) : 0.0;
+  int body_x1 = lcov < 1.0 ? ix1 + 1 : ix1;
+  int body_x2 = rcov > 0.0 && rcov < 1.0 ? ix2 - 1 : ix2;
+
+  PixFmt &pix = ren.ren();
+  for(int y = iy1; y < iy2; y++) {
+    double ycov = std::min(y2, y + 1.0) - std::max(y1, static_cast<double>(y));
+    unsigned cover = static_cast<unsigned>(std::lround(ycov * 255));
+    uint8_t *row = pix.row_ptr(y);
+    if(body_x1 < body_x2)
+      rect_blend_span(row + body_x1 * 4, body_x2 - body_x1, rect_src(c, cover));
+    if(body_x1 != ix1)
+      rect_blend_span(row + ix1 * 4, 1, rect_src(c, static_cast<unsigned>(std::lround(ycov * lcov * 255))));
+    if(body_x2 != ix2)
+      rect_blend_span(row + body_x2 * 4, 1, rect_src(c, static_cast<unsigned>(std::lround(ycov * rcov * 255))));
+  }
+}
+
+}
@@ -0,0 +1,137 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "agg_color_rgba.h"
+#include "agg_gradient_lut.h"
+
+#include "bar/gc/colors/kanagawa.hpp"
+#include "bar/gc/colorscheme.hpp"
+
+namespace bar {
+
+enum class panel_flavor_t { none, datetime, logo, tagsel, tagsel_active, winsel, winsel_active, volume, im, tagsel_occ, tagsel_urg, winsel_hidden, ltbutton };
+
+inline constexpr std::size_t panel_flavor_count = static_cast<std::size_t>(panel_flavor_t::ltbutton) + 1;
+
+// the theme, only consulted when the style table is (re)built
+
+inline agg::rgba8 theme_color(rgb_literal_t lit, uint8_t a = 255) { return as_color<agg::rgba8>(lit, a); }
+
+inline agg::rgba8 theme_panel_bg(panel_flavor_t flavor) {
+  switch(flavor) {
+  case panel_flavor_t::datetime:
+    return theme_color(colors::kanagawa::waveBlue1);
+  case panel_flavor_t::logo:
+    return theme_color(colors::kanagawa::sumiInk1);
+  case panel_flavor_t::tagsel:
+    return theme_color(colors::kanagawa::waveBlue1, 204);
+  case panel_flavor_t::tagsel_active:
+    return theme_color(colors::kanagawa::waveBlue2);
+  case panel_flavor_t::ltbutton:
+    return theme_color(colors::kanagawa::winterBlue);
+  case panel_flavor_t::winsel_active:
+    return theme_color(colors::kanagawa::fujiWhite);
+  case panel_flavor_t::im:
+    return theme_color(colors::kanagawa::winterBlue);
+  case panel_flavor_t::volume:
+    return theme_color(colors::kanagawa::sumiInk3);
+  case panel_flavor_t::none:   // fallthrough
+  case panel_flavor_t::winsel: // fallthrough
+  default:
+    return theme_color(colors::kanagawa::sumiInk3, 204);
+  }
+}
+
+inline agg::rgba8 theme_panel_pin(panel_flavor_t flavor) {
+  switch(flavor) {
+  case panel_flavor_t::tagsel_urg:
+    return theme_color(colors::kanagawa::peachRed);
+  case panel_flavor_t::tagsel_occ:
+    return theme_color(colors::kanagawa::fujiWhite);
+  case panel_flavor_t::winsel_hidden:
+    return theme_color(colors::kanagawa::katanaGray);
+  default:
+    return theme_color(colors::kanagawa::winterBlue);
+  }
+}
+
+inline agg::rgba8 theme_volbar_plate(panel_flavor_t) { return theme_color(colors::kanagawa::fujiGray); }
+
+inline agg::rgba8 theme_panel_fg(panel_flavor_t flavor) {
+  switch(flavor) {
+  case panel_flavor_t::datetime:
+    return theme_color(colors::kanagawa::springBlue);
+  case panel_flavor_t::logo:
+    return theme_color(colors::kanagawa::springViolet1);
+  case panel_flavor_t::winsel_active:
+    return theme_color(colors::kanagawa::waveBlue2);
+  case panel_flavor_t::tagsel:
+    return theme_color(colors::kanagawa::surimiOrange);
+  case panel_flavor_t::tagsel_active:
+    return theme_color(colors::kanagawa::surimiOrange);
+  case panel_flavor_t::ltbutton: // fallthrough
+  case panel_flavor_t::none:     // fallthrough
+  default:
+    return theme_color(colors::kanagawa::fujiWhite);
+  }
+}
+
+inline std::string theme_font_selector(panel_flavor_t) {
+  // return "deja vu sans mono";
+  return "monospace";
+}
+
+using fade_lut_t = agg::gradient_lut<agg::color_interpolator<agg::rgba8>, 256>;
+
+// everything a draw call needs to know about a flavor, resolved once
+struct panel_style_t {
+  agg::rgba8 bg;
+  agg::rgba8 fg;
+  agg::rgba8 pin;
+  agg::rgba8 volbar_plate;
+  std::string font; // fontconfig selector, also part of the text run cache key
+  fade_lut_t fade;  // fg over the first 80% of an overflowing text, then fading to transparent
+};
+
+struct panel_styles_t {
+  panel_styles_t() { rebuild(); }
+
+  // draw calls read the table without locking, rebuild only with no frame being rendered
+  void rebuild() {
+    for(std::size_t i = 0; i < panel_flavor_count; i++) {
+      auto flavor = static_cast<panel_flavor_t>(i);
+      panel_style_t &style = styles_[i];
+      style.bg = theme_panel_bg(flavor);
+      style.fg = theme_panel_fg(flavor);
+      style.pin = theme_panel_pin(flavor);
+      style.volbar_plate = theme_volbar_plate(flavor);
+      style.font = theme_font_selector(flavor);
+      auto fg_fade = style.fg;
+      fg_fade.a = 0;
+      style.fade.remove_all();
+      style.fade.add_color(0.0, style.fg);
+      style.fade.add_color(0.8, style.fg);
+      style.fade.add_color(1.0, fg_fade);
+      style.fade.build_lut();
+    }
+    generation_++;
+  }
+
+  panel_style_t &operator[](panel_flavor_t flavor) { return styles_[static_cast<std::size_t>(flavor)]; }
+
+  const panel_style_t &operator[](panel_flavor_t flavor) const { return styles_[static_cast<std::size_t>(flavor)]; }
+
+  std::array<panel_style_t, panel_flavor_count> styles_;
+  uint64_t generation_ = 0;
+};
+
+inline panel_styles_t &pstyles() {
+  static panel_styles_t s;
+  return s;
+}
+
+}
@@ -0,0 +1,365 @@
+#pragma once
+
+#include <X11/Xlib.h>
+#include <X11/extensions/Xrender.h>
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "agg_path_storage.h"
+#include "agg_rasterizer_scanline_aa.h"
+#include "agg_scanline_u.h"
+
+#include "bar/gc/gc.hpp"
+
+namespace bar {
+
+// draws the same primitives as agg_gc_t straight into a server side Picture, glyph coverage is rasterized by agg once
+// and kept in an XRender GlyphSet so text costs a few glyph indices per frame, panels are filled rectangles and the
+// server composites everything with premultiplied alpha
+struct xrender_gc_t : zone_draw_t<xrender_gc_t> {
+  using zone_api = zone_draw_t<xrender_gc_t>;
+  using zone_api::draw_ltbutton_icon;
+  using zone_api::draw_panel_bg;
+  using zone_api::draw_panel_pin;
+  using zone_api::draw_text;
+  using zone_api::draw_volbar;
+
+  // glyphs uploaded before the set is dropped and started over, each costs its coverage bytes in the server
+  static constexpr std::size_t max_glyphs = 4096;
+
+  explicit xrender_gc_t(Display *dpy) : dpy_(dpy) {}
+
+  xrender_gc_t(const xrender_gc_t &) = delete;
+  xrender_gc_t &operator=(const xrender_gc_t &) = delete;
+
+  ~xrender_gc_t() {
+    reset_glyphs();
+    for(auto &[color, pict] : solids_)
+      XRenderFreePicture(dpy_, pict);
+  }
+
+  static bool available(Display *dpy) {
+    int event_base, error_base;
+    return XRenderQueryExtension(dpy, &event_base, &error_base);
+  }
+
+  // the Picture drawn into until the next target()
+  void target(Picture dst) { dst_ = dst; }
+
+  void begin_zone(const zone_t &z) {
+    XRectangle r = pixel_rect(z.x, z.y, z.x + z.w, z.y + z.h);
+    XRenderSetPictureClipRectangles(dpy_, dst_, 0, 0, &r, 1);
+    XRenderColor clear{ 0, 0, 0, 0 };
+    XRenderFillRectangle(dpy_, PictOpSrc, dst_, &clear, r.x, r.y, r.width, r.height);
+  }
+
+  // like begin_zone(z), but the zone starts out as the same pixels of backdrop, a picture laid over the whole target
+  void begin_zone(const zone_t &z, Picture backdrop) {
+    if(backdrop == None)
+      return begin_zone(z);
+    XRectangle r = pixel_rect(z.x, z.y, z.x + z.w, z.y + z.h);
+    XRenderSetPictureClipRectangles(dpy_, dst_, 0, 0, &r, 1);
+    XRenderComposite(dpy_, PictOpSrc, backdrop, None, dst_, r.x, r.y, 0, 0, r.x, r.y, r.width, r.height);
+  }
+
+  void end_zone() {
+    XRenderPictureAttributes pa;
+    pa.clip_mask = None;
+    XRenderChangePicture(dpy_, dst_, CPClipMask, &pa);
+  }
+
+  void fill_rect(double x1, double y1, double x2, double y2, const agg::rgba8 &color) {
+    if(x1 > x2)
+      std::swap(x1, x2);
+    if(y1 > y2)
+      std::swap(y1, y2);
+    if(color.a == 0 || x1 >= x2 || y1 >= y2)
+      return;
+    // pixel aligned rectangles are filled directly, anything else keeps its antialiased edges as a trapezoid
+    if(x1 == std::floor(x1) && y1 == std::floor(y1) && x2 == std::floor(x2) && y2 == std::floor(y2)) {
+      XRenderColor c = render_color(color);
+      XRenderFillRectangle(dpy_, PictOpOver, dst_, &c, static_cast<int>(x1), static_cast<int>(y1), static_cast<unsigned>(x2 - x1),
+                           static_cast<unsigned>(y2 - y1));
+      return;
+    }
+    begin_paths();
+    add_rect(x1, y1, x2, y2);
+    fill_paths(color);
+  }
+
+  void draw_volbar(double rate, double x, double y, double w, double h, panel_flavor_t flavor = panel_flavor_t::none) {
+    fill_rect(x, y, x + w, y + h, pstyles()[flavor].volbar_plate);
+    fill_rect(x, y, x + (w * rate), y + h, pstyles()[flavor].fg);
+  }
+
+  void draw_ltbutton_icon(ltbutton_icon_t icon, double x, double y, double w, double h, panel_flavor_t flavor = panel_flavor_t::none) {
+    switch(icon) {
+    case ltbutton_icon_t::monocle:
+      fill_rect(x, y, x + w, y + h, pstyles()[flavor].fg);
+      return;
+    case ltbutton_icon_t::floating:
+      begin_paths();
+      add_floating_icon(x, y, w, h);
+      fill_paths(pstyles()[flavor].fg);
+      return;
+    default: {
+      double x1 = x + w * 0.45;
+      double x2 = x + w * 0.55;
+      double x3 = x + w;
+      double y1 = y + h * 0.45;
+      double y2 = y + h * 0.55;
+      double y3 = y + h;
+      fill_rect(x, y, x1, y3, pstyles()[flavor].fg);
+      fill_rect(x2, y, x3, y1, pstyles()[flavor].fg);
+      fill_rect(x2, y2, x3, y3, pstyles()[flavor].fg);
+      return;
+    }
+    }
+  }
+
+  void draw_panel_bg(double x, double y, double w, double h, panel_flavor_t flavor = panel_flavor_t::none) {
+    fill_rect(x, y, x + w, y + h, pstyles()[flavor].bg);
+  }
+
+  void draw_panel_pin(double x, double y, double a, panel_flavor_t flavor = panel_flavor_t::none) {
+    begin_paths();
+    add_panel_pin(x, y, a);
+    fill_paths(pstyles()[flavor].pin);
+  }
+
+  void begin_paths() {
+    traps_.clear();
+    tris_.clear();
+  }
+
+  // the same two L shapes as agg_gc_t, as four rectangles
+  void add_floating_icon(double x, double y, double w, double h) {
+    double x1 = x + (w / 3);
+    double x2 = x + (w / 3) * 2;
+    double x3 = x + w;
+    double y1 = y + (h / 3);
+    double y2 = y + (h / 3) * 2;
+    double y3 = y + h;
+    add_rect(x, y1, x1, y3);
+    add_rect(x1, y2, x2, y3);
+    add_rect(x1, y, x3, y1);
+    add_rect(x2, y1, x3, y2);
+  }
+
+  void add_panel_pin(double x, double y, double a) {
+    XTriangle t;
+    t.p1 = XPointFixed{ XDoubleToFixed(x), XDoubleToFixed(y) };
+    t.p2 = XPointFixed{ XDoubleToFixed(x + a), XDoubleToFixed(y) };
+    t.p3 = XPointFixed{ XDoubleToFixed(x), XDoubleToFixed(y + a) };
+    tris_.push_back(t);
+  }
+
+  // composites every shape added since begin_paths() through one a8 mask per primitive kind
+  void fill_paths(const agg::rgba8 &color) {
+    Picture src = solid(color);
+    if(!traps_.empty())
+      XRenderCompositeTrapezoids(dpy_, PictOpOver, src, dst_, a8(), 0, 0, traps_.data(), static_cast<int>(traps_.size()));
+    if(!tris_.empty())
+      XRenderCompositeTriangles(dpy_, PictOpOver, src, dst_, a8(), 0, 0, tris_.data(), static_cast<int>(tris_.size()));
+    begin_paths();
+  }
+
+  // positions glyphs exactly like agg_gc_t::draw_text, an overflowing text is filled through a gradient picture instead
+  void draw_text(std::string_view txt, double x, double bl_y, double w, double h, panel_flavor_t flavor = panel_flavor_t::none) {
+    panel_style_t &style = pstyles()[flavor];
+    unsigned height = static_cast<unsigned>(h);
+    std::shared_ptr<const text_run_t> run_ptr;
+    {
+      std::lock_guard<std::mutex> lock{ font_mutex() };
+      run_ptr = fruns().get(txt, style.font, height);
+    }
+    const text_run_t &run = *run_ptr;
+    double x_max = x + w;
+    bool fade_out = run.width > w;
+
+    if(!fade_out)
+      x += (w - run.width) / 2;
+
+    // the set is only ever dropped between texts, the elements below all point into the current one
+    {
+      std::lock_guard<std::mutex> lock{ font_mutex() };
+      if(generation_ != fmatcher().generation_ || ids_by_key_.size() + run.glyphs.size() > max_glyphs) {
+        reset_glyphs();
+        generation_ = fmatcher().generation_;
+      }
+    }
+    if(!glyphs_)
+      glyphs_ = XRenderCreateGlyphSet(dpy_, a8());
+
+    int bl_yi = static_cast<int>(std::lround(bl_y));
+    ids_.clear();
+    elts_.clear();
+    int pen_x = 0;
+    for(const text_run_glyph_t &glyph : run.glyphs) {
+      if(fade_out && x > x_max)
+        break;
+      double x_floor = std::floor(x);
+      int xi = static_cast<int>(x_floor);
+      unsigned subpx = static_cast<unsigned>(std::lround((x - x_floor) * glyph_subpixel_steps));
+      if(subpx == glyph_subpixel_steps) {
+        xi++;
+        subpx = 0;
+      }
+      x += glyph.advance_x;
+      Glyph id;
+      if(!glyph_id(glyph, height, subpx, id))
+        continue;
+      XGlyphElt32 elt;
+      elt.glyphset = glyphs_;
+      elt.chars = nullptr;
+      elt.nchars = 1;
+      elt.xOff = elts_.empty() ? xi : xi - pen_x;
+      elt.yOff = elts_.empty() ? bl_yi : 0;
+      pen_x = xi;
+      ids_.push_back(static_cast<unsigned>(id));
+      elts_.push_back(elt);
+    }
+    if(elts_.empty())
+      return;
+    for(std::size_t i = 0; i < elts_.size(); i++)
+      elts_[i].chars = &ids_[i];
+
+    // the source origin is the first glyph's, the gradient is laid out in destination coordinates like agg's span_gradient
+    int x0 = elts_[0].xOff;
+    if(fade_out) {
+      Picture src = fade(style, x_max - w, w);
+      XRenderCompositeText32(dpy_, PictOpOver, src, dst_, None, x0, bl_yi, x0, bl_yi, elts_.data(), static_cast<int>(elts_.size()));
+      XRenderFreePicture(dpy_, src);
+    } else {
+      XRenderCompositeText32(dpy_, PictOpOver, solid(style.fg), dst_, None, 0, 0, x0, bl_yi, elts_.data(), static_cast<int>(elts_.size()));
+    }
+  }
+
+private:
+  static XRectangle pixel_rect(double x1, double y1, double x2, double y2) {
+    XRectangle r;
+    r.x = static_cast<short>(std::lround(x1));
+    r.y = static_cast<short>(std::lround(y1));
+    r.width = static_cast<unsigned short>(std::lround(x2) - r.x);
+    r.height = static_cast<unsigned short>(std::lround(y2) - r.y);
+    return r;
+  }
+
+  // render colors are premultiplied 16 bit channels
+  static XRenderColor render_color(const agg::rgba8 &c) {
+    auto pre = [&](unsigned v) { return static_cast<unsigned short>(v * c.a / 255 * 257); };
+    return XRenderColor{ pre(c.r), pre(c.g), pre(c.b), static_cast<unsigned short>(c.a * 257) };
+  }
+
+  void add_rect(double x1, double y1, double x2, double y2) {
+    XTrapezoid t;
+    t.top = XDoubleToFixed(y1);
+    t.bottom = XDoubleToFixed(y2);
+    t.left = XLineFixed{ XPointFixed{ XDoubleToFixed(x1), XDoubleToFixed(y1) }, XPointFixed{ XDoubleToFixed(x1), XDoubleToFixed(y2) } };
+    t.right = XLineFixed{ XPointFixed{ XDoubleToFixed(x2), XDoubleToFixed(y1) }, XPointFixed{ XDoubleToFixed(x2), XDoubleToFixed(y2) } };
+    traps_.push_back(t);
+  }
+
+  XRenderPictFormat *a8() {
+    if(!a8_)
+      a8_ = XRenderFindStandardFormat(dpy_, PictStandardA8);
+    return a8_;
+  }
+
+  // a 1x1 solid fill per color, the style table only has a handful
+  Picture solid(const agg::rgba8 &color) {
+    uint32_t key = (uint32_t(color.r) << 24) | (uint32_t(color.g) << 16) | (uint32_t(color.b) << 8) | color.a;
+    auto it = solids_.find(key);
+    if(it != solids_.end())
+      return it->second;
+    XRenderColor c = render_color(color);
+    return solids_.emplace(key, XRenderCreateSolidFill(dpy_, &c)).first->second;
+  }
+
+  // fg over the first 80% of [x, x + w) fading out to transparent, padded on both sides like the lut clamps
+  Picture fade(const panel_style_t &style, double x, double w) {
+    XLinearGradient lg;
+    lg.p1 = XPointFixed{ XDoubleToFixed(x), 0 };
+    lg.p2 = XPointFixed{ XDoubleToFixed(x + w), 0 };
+    XFixed stops[3] = { XDoubleToFixed(0.0), XDoubleToFixed(0.8), XDoubleToFixed(1.0) };
+    // gradient stops are not premultiplied
+    XRenderColor fg{ static_cast<unsigned short>(style.fg.r * 257), static_cast<unsigned short>(style.fg.g * 257),
+                     static_cast<unsigned short>(style.fg.b * 257), static_cast<unsigned short>(style.fg.a * 257) };
+    XRenderColor clear = fg;
+    clear.alpha = 0;
+    XRenderColor colors[3] = { fg, fg, clear };
+    Picture pict = XRenderCreateLinearGradient(dpy_, &lg, stops, colors, 3);
+    XRenderPictureAttributes pa;
+    pa.repeat = RepeatPad;
+    XRenderChangePicture(dpy_, pict, CPRepeat, &pa);
+    return pict;
+  }
+
+  // uploads the glyph's coverage on first use, false for glyphs without any ink
+  bool glyph_id(const text_run_glyph_t &glyph, unsigned height, unsigned subpx, Glyph &id) {
+    glyph_mask_key_t key{ glyph.tok, height, glyph.code, subpx };
+    auto it = ids_by_key_.find(key);
+    if(it != ids_by_key_.end()) {
+      id = it->second;
+      return id != None;
+    }
+
+    auto mask_ptr = bar::glyph_mask(outline_, ras_, sl_, glyph, height, subpx);
+    const glyph_mask_t &mask = *mask_ptr;
+    if(mask.w == 0 || mask.h == 0) {
+      ids_by_key_.emplace(key, None);
+      return false;
+    }
+
+    // a8 glyph rows are padded to 32 bits
+    unsigned stride = (mask.w + 3) & ~3u;
+    upload_.assign(stride * mask.h, 0);
+    for(unsigned r = 0; r < mask.h; r++)
+      std::memcpy(upload_.data() + r * stride, mask.row(r), mask.w);
+    XGlyphInfo info;
+    info.width = static_cast<unsigned short>(mask.w);
+    info.height = static_cast<unsigned short>(mask.h);
+    info.x = static_cast<short>(-mask.x);
+    info.y = static_cast<short>(-mask.y);
+    info.xOff = 0;
+    info.yOff = 0;
+    id = ++last_id_;
+    XRenderAddGlyphs(dpy_, glyphs_, &id, &info, 1, upload_.data(), static_cast<int>(upload_.size()));
+    ids_by_key_.emplace(key, id);
+    return true;
+  }
+
+  void reset_glyphs() {
+    if(glyphs_)
+      XRenderFreeGlyphSet(dpy_, glyphs_);
+    glyphs_ = None;
+    ids_by_key_.clear();
+    last_id_ = 0;
+  }
+
+  Display *dpy_;
+  Picture dst_ = None;
+  XRenderPictFormat *a8_ = nullptr;
+  GlyphSet glyphs_ = None;
+  Glyph last_id_ = 0;
+  uint64_t generation_ = 0;
+  std::unordered_map<glyph_mask_key_t, Glyph, glyph_mask_key_hash_t> ids_by_key_;
+  std::map<uint32_t, Picture> solids_;
+  std::vector<XTrapezoid> traps_;
+  std::vector<XTriangle> tris_;
+  std::vector<XGlyphElt32> elts_;
+  std::vector<unsigned> ids_;
+  std::vector<char> upload_;
+  agg::path_storage outline_;
+  agg::rasterizer_scanline_aa<> ras_;
+  agg::scanline_u8 sl_;
+};
+
+}
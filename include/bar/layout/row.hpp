@@ -0,0 +1,57 @@
+#pragma once
+
+#include "bar/layout/zone.hpp"
+
+#include <cmath>
+#include <cstddef>
+
+namespace bar {
+
+enum class row_edge_t { left, right, fill };
+
+// one slot of a bar row, w is in pixels and ignored for fill slots
+struct row_item_t {
+  row_edge_t edge = row_edge_t::left;
+  double w = 0;
+};
+
+// left slots are packed from the left edge and right slots from the right edge, both in item order, fill slots share
+// what remains between them. false when nothing remains, the fill zones are empty then
+inline bool layout_row(double w, double h, const row_item_t *items, std::size_t n, zone_t *out) {
+  double left = 0;
+  double right = w;
+  std::size_t nfill = 0;
+
+  for(std::size_t i = 0; i < n; i++) {
+    switch(items[i].edge) {
+    case row_edge_t::left:
+      out[i] = zone_t{ left, 0, items[i].w, h };
+      left += items[i].w;
+      break;
+    case row_edge_t::right:
+      right -= items[i].w;
+      out[i] = zone_t{ right, 0, items[i].w, h };
+      break;
+    case row_edge_t::fill:
+      out[i] = zone_t{};
+      nfill++;
+      break;
+    }
+  }
+  if(right <= left)
+    return false;
+
+  // whole pixel edges, like every other zone
+  std::size_t j = 0;
+  for(std::size_t i = 0; i < n; i++) {
+    if(items[i].edge != row_edge_t::fill)
+      continue;
+    double x0 = left + std::round((right - left) * j / nfill);
+    double x1 = left + std::round((right - left) * (j + 1) / nfill);
+    out[i] = zone_t{ x0, 0, x1 - x0, h };
+    j++;
+  }
+  return true;
+}
+
+}
@@ -1,7 +1,12 @@
 #pragma once
 
+#include "bar/layout/row.hpp"
 #include "bar/layout/zone.hpp"
 
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
 namespace bar {
 
 struct wmbar_layout_t {
@@ -24,68 +29,32 @@ constexpr layout_flag_t has_im = 1 << 3;
 constexpr layout_flag_t has_volume = 1 << 4;
 }
 
+// zone edges are whole pixels, so every zone can be cleared and redrawn without touching its neighbours
 inline wmbar_layout_t layout_wmbar(double w, double h, unsigned tags, layout_flag_t flags) {
-  double curr_x = 0;
-  double curr_x_bak = w;
   wmbar_layout_t layo;
-
-  // left to right
-
-  layo.logo_.x = curr_x;
-  layo.logo_.y = 0;
-  layo.logo_.w = h * 3;
-  layo.logo_.h = h;
-  curr_x += layo.logo_.w;
-
-  layo.tags_.x = curr_x;
-  layo.tags_.y = 0;
-  layo.tags_.w = h * 1.2 * tags;
-  layo.tags_.h = h;
-  curr_x += layo.tags_.w;
-
-  layo.ltbutton_.x = curr_x;
-  layo.ltbutton_.y = 0;
-  layo.ltbutton_.w = h * 1.2;
-  layo.ltbutton_.h = h;
-  curr_x += layo.ltbutton_.w;
-
-  // right to left
-
-  layo.time_.y = 0;
-  layo.time_.w = h * 4;
-  layo.time_.h = h;
-  layo.time_.x = curr_x_bak - layo.time_.w;
-  curr_x_bak -= layo.time_.w;
-
-  if(flags & layout_flags::has_volume) {
-    layo.volume_.y = 0;
-    layo.volume_.w = h * 2.5;
-    layo.volume_.h = h;
-    layo.volume_.x = curr_x_bak - layo.volume_.w;
-    curr_x_bak -= layo.volume_.w;
-  }
-
-  if(flags & layout_flags::has_im) {
-    layo.im_.y = 0;
-    layo.im_.w = h * 1.2;
-    layo.im_.h = h;
-    layo.im_.x = curr_x_bak - layo.im_.w;
-    curr_x_bak -= layo.im_.w;
-  }
-
-  // remaining
-
-  if(curr_x_bak <= curr_x) {
-    layo.good_ = false;
-    return layo;
-  }
-
-  layo.wins_.x = curr_x;
-  layo.wins_.y = 0;
-  layo.wins_.w = curr_x_bak - curr_x;
-  layo.wins_.h = h;
-
-  layo.good_ = true;
+  row_item_t items[7];
+  zone_t *zones[7];
+  zone_t out[7];
+  std::size_t n = 0;
+
+  auto add = [&](zone_t &z, row_edge_t edge, double zw) {
+    items[n] = row_item_t{ edge, zw };
+    zones[n++] = &z;
+  };
+
+  add(layo.logo_, row_edge_t::left, std::round(h * 3));
+  add(layo.tags_, row_edge_t::left, std::round(h * 1.2 * tags));
+  add(layo.ltbutton_, row_edge_t::left, std::round(h * 1.2));
+  add(layo.wins_, row_edge_t::fill, 0);
+  add(layo.time_, row_edge_t::right, std::round(h * 4));
+  if(flags & layout_flags::has_volume)
+    add(layo.volume_, row_edge_t::right, std::round(h * 2.5));
+  if(flags & layout_flags::has_im)
+    add(layo.im_, row_edge_t::right, std::round(h * 1.2));
+
+  layo.good_ = layout_row(w, h, items, n, out);
+  for(std::size_t i = 0; i < n; i++)
+    *zones[i] = out[i];
   return layo;
 }
 
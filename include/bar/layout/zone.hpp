@@ -1,7 +1,11 @@
 #pragma once
 
+#include <cstddef>
 #include <cstdint>
-#include <vector>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
 
 namespace bar {
 
@@ -19,15 +23,45 @@ struct zone_attr_t {
   double volbar_ratio = 0;
 };
 
-inline std::vector<zone_t> xsplit(zone_t z, double n) {
-  std::vector<zone_t> ret;
-  zone_t sep = z;
-  sep.w = z.w / n;
-  for(double i = 0; i < n; i++) {
-    ret.push_back(sep);
-    sep.x += z.w / n;
+// the inputs a zone was last drawn from, add() everything the zone depends on then commit() to learn whether it changed
+struct zone_snapshot_t {
+  template <class T> zone_snapshot_t &add(const T &v) {
+    static_assert(std::is_trivially_copyable_v<T>);
+    next_.append(reinterpret_cast<const char *>(&v), sizeof(v));
+    return *this;
   }
-  return ret;
-}
+
+  zone_snapshot_t &add(std::string_view s) {
+    add(s.size());
+    next_.append(s);
+    return *this;
+  }
+
+  bool commit() {
+    bool changed = !valid_ || next_ != prev_;
+    std::swap(next_, prev_);
+    next_.clear();
+    valid_ = true;
+    return changed;
+  }
+
+  void invalidate() { valid_ = false; }
+
+  bool valid_ = false;
+  std::string prev_;
+  std::string next_;
+};
+
+// z cut into n equal columns, computed on access so splitting never allocates
+struct xsplit_t {
+  zone_t z;
+  std::size_t n = 0;
+
+  std::size_t size() const noexcept { return n; }
+
+  zone_t operator[](std::size_t i) const noexcept { return zone_t{ z.x + z.w / n * i, z.y, z.w / n, z.h }; }
+};
+
+inline xsplit_t xsplit(zone_t z, std::size_t n) { return xsplit_t{ z, n }; }
 
 };
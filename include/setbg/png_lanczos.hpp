@@ -2,6 +2,8 @@
 
 #include <X11/Xlib.h>
 
+#include "ytk/x/shm.hpp"
+
 #include "agg_image_accessors.h"
 #include "agg_image_filters.h"
 #include "agg_pixfmt_rgba.h"
@@ -59,38 +61,28 @@ template <class SrcPixelFormat, class DstPixelFormat> void fit(const SrcPixelFor
   agg::render_scanlines_aa(ras, scanline, dst, sa, sg);
 }
 
-void draw_png(const std::string &path, Display *dpy, Drawable draw, GC gc, unsigned x, unsigned y, unsigned w, unsigned h, unsigned depth) {
-  std::vector<uint8_t> dst_data;
-  dst_data.resize(w * h * 4);
-
-  XImage img;
-  img.width = w;
-  img.height = h;
-  img.xoffset = 0;
-  img.format = ZPixmap;
-  img.data = reinterpret_cast<char *>(dst_data.data());
-  img.byte_order = ImageByteOrder(dpy);
-  img.bitmap_unit = 32;
-  img.bitmap_bit_order = ImageByteOrder(dpy);
-  img.bitmap_pad = 32;
-  img.depth = depth;
-  img.bits_per_pixel = 32;
-  img.bytes_per_line = w * 4;
-  img.red_mask = 0x00ff0000;
-  img.green_mask = 0x0000ff00;
-  img.blue_mask = 0x000000ff;
-  img.obdata = 0;
-  XInitImage(&img);
+// fitted(img) sees the scaled wallpaper before it is put, e.g. to derive something from it
+template <class Fitted>
+void draw_png(const std::string &path, ytk::x::shm_pool_t &shm, Drawable draw, GC gc, unsigned x, unsigned y, unsigned w, unsigned h, unsigned depth,
+              Fitted &&fitted) {
+  Display *dpy = shm.display();
+  ytk::x::shm_image_t img;
+  img.create(shm, DefaultVisual(dpy, DefaultScreen(dpy)), depth, w, h);
 
   png::image<png::rgba_pixel, png::solid_pixel_buffer<png::rgba_pixel>> png{ path };
   agg::rendering_buffer rbuf{ png.get_pixbuf().get_bytes().data(), static_cast<unsigned>(png.get_width()), static_cast<unsigned>(png.get_height()),
                               static_cast<int>(png.get_pixbuf().get_stride()) };
   agg::pixfmt_rgba32 pix{ rbuf };
-  agg::rendering_buffer rbuf_dst{ dst_data.data(), w, h, static_cast<int>(w * 4) };
+  agg::rendering_buffer rbuf_dst{ img.data(), w, h, img.stride() };
   agg::pixfmt_bgra32 pix_dst{ rbuf_dst };
   fit(pix, pix_dst);
+  fitted(img);
+
+  img.put(draw, gc, 0, 0, x, y, w, h);
+}
 
-  XPutImage(dpy, draw, gc, &img, 0, 0, x, y, w, h);
+inline void draw_png(const std::string &path, ytk::x::shm_pool_t &shm, Drawable draw, GC gc, unsigned x, unsigned y, unsigned w, unsigned h, unsigned depth) {
+  draw_png(path, shm, draw, gc, x, y, w, h, depth, [](ytk::x::shm_image_t &) {});
 }
 
 }
@@ -20,6 +20,15 @@ struct expose_t {
   std::string stringify() const { return "exposed"; }
 };
 
+// a frame of win_t's frame clock is due, now is steady clock seconds
+struct frame_t {
+  frame_t(double now) : now(now) {}
+
+  std::string stringify() const { return fmt::format("frame at {:.3f}", now); }
+
+  double now = 0;
+};
+
 struct win_resize_t {
   win_resize_t(unsigned width, unsigned height) : width(width), height(height) {}
 
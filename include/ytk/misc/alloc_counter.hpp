@@ -0,0 +1,21 @@
+#pragma once
+
+#include <cstdint>
+
+namespace ytk {
+
+// operator new calls made by the calling thread, only counted where a translation unit replaces the global
+// allocation functions to bump it (dwmz does in debug builds, see src/dwmz/alloccount.cpp), zero everywhere else
+inline uint64_t &thread_allocs() noexcept {
+  static thread_local uint64_t n = 0;
+  return n;
+}
+
+// allocations made by this thread since construction
+struct alloc_scope_t {
+  uint64_t count() const noexcept { return thread_allocs() - start_; }
+
+  uint64_t start_ = thread_allocs();
+};
+
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+namespace ytk {
+
+// bump allocator for data that lives exactly one frame, reset() drops everything at once and folds any overflow
+// into a single block sized for the largest frame so far, after which a frame of the same size never reaches the heap
+struct frame_arena_t {
+  explicit frame_arena_t(std::size_t capacity = 16 * 1024) : block_(new std::byte[capacity]), capacity_(capacity) {}
+
+  frame_arena_t(const frame_arena_t &) = delete;
+  frame_arena_t &operator=(const frame_arena_t &) = delete;
+  frame_arena_t(frame_arena_t &&) = default;
+  frame_arena_t &operator=(frame_arena_t &&) = default;
+
+  void *allocate(std::size_t size, std::size_t align = alignof(std::max_align_t)) {
+    std::size_t at = (used_ + align - 1) & ~(align - 1);
+    if(at + size <= capacity_) {
+      used_ = at + size;
+      return block_.get() + at;
+    }
+    overflow_bytes_ += size + align;
+    auto &extra = overflow_.emplace_back(new std::byte[size + align]);
+    void *p = extra.get();
+    std::size_t space = size + align;
+    return std::align(align, size, p, space);
+  }
+
+  template <class T> T *copy(const T *src, std::size_t n) {
+    if(n == 0)
+      return nullptr;
+    T *dst = static_cast<T *>(allocate(sizeof(T) * n, alignof(T)));
+    std::memcpy(dst, src, sizeof(T) * n);
+    return dst;
+  }
+
+  void reset() {
+    if(!overflow_.empty()) {
+      capacity_ = std::max(capacity_ * 2, capacity_ + overflow_bytes_);
+      block_.reset(new std::byte[capacity_]);
+      overflow_.clear();
+      overflow_bytes_ = 0;
+    }
+    used_ = 0;
+  }
+
+  std::size_t capacity() const noexcept { return capacity_; }
+
+  std::size_t used() const noexcept { return used_ + overflow_bytes_; }
+
+private:
+  std::unique_ptr<std::byte[]> block_;
+  std::size_t capacity_ = 0;
+  std::size_t used_ = 0;
+  std::vector<std::unique_ptr<std::byte[]>> overflow_;
+  std::size_t overflow_bytes_ = 0;
+};
+
+}
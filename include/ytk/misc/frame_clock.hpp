@@ -0,0 +1,74 @@
+#pragma once
+
+#include <algorithm>
+#include <vector>
+
+namespace ytk {
+
+// eases values of a few targets over short spans of time, ticked by one timer at the output refresh rate. the owner
+// keeps that timer running only while active(), so an idle clock costs no wakeups at all. each tick() hands out the
+// targets still moving, the owner repaints just their regions
+template <class Target> struct frame_clock_t {
+  struct anim_t {
+    Target target;
+    double from = 0;
+    double to = 0;
+    double start = 0;
+    double duration = 0;
+  };
+
+  // moves target from `from` to `to` starting at now, replaces whatever animation target had
+  void animate(const Target &target, double from, double to, double now, double duration) {
+    now_ = std::max(now_, now);
+    cancel(target);
+    anims_.push_back(anim_t{ target, from, to, now_, duration });
+  }
+
+  void cancel(const Target &target) {
+    cancel_if([&](const Target &t) { return t == target; });
+  }
+
+  template <class Pred> void cancel_if(Pred pred) {
+    anims_.erase(std::remove_if(anims_.begin(), anims_.end(), [&](const anim_t &a) { return pred(a.target); }), anims_.end());
+  }
+
+  // what target shows in the current frame, rest when it is not moving
+  double value(const Target &target, double rest) const {
+    for(const auto &a : anims_) {
+      if(a.target == target) {
+        double t = a.duration > 0 ? std::min((now_ - a.start) / a.duration, 1.0) : 1.0;
+        double eased = 1 - (1 - t) * (1 - t) * (1 - t); // ease out cubic
+        return a.from + (a.to - a.from) * eased;
+      }
+    }
+    return rest;
+  }
+
+  bool active() const noexcept { return !anims_.empty(); }
+
+  // the largest f(target) over the moving targets, 0 when nothing moves
+  template <class F> double max_over(F &&f) const {
+    double m = 0;
+    for(const auto &a : anims_)
+      m = std::max(m, static_cast<double>(f(a.target)));
+    return m;
+  }
+
+  // starts the frame at now and calls f(target) for each moving target, the ones reaching their end in this frame
+  // are dropped after it
+  template <class F> void tick(double now, F &&f) {
+    now_ = std::max(now_, now);
+    for(const auto &a : anims_)
+      f(a.target);
+    anims_.erase(std::remove_if(anims_.begin(), anims_.end(), [&](const anim_t &a) { return now_ >= a.start + a.duration; }), anims_.end());
+  }
+
+  // seconds between ticks at hz, 60 Hz if the refresh rate is unknown
+  static double interval(double hz) { return 1.0 / (hz > 0 ? hz : 60.0); }
+
+private:
+  double now_ = 0;
+  std::vector<anim_t> anims_;
+};
+
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+#include "date/date.h"
+#include "date/tz.h"
+
+namespace ytk {
+
+struct local_time_of_day_t {
+  unsigned hours = 0;
+  unsigned minutes = 0;
+  unsigned seconds = 0;
+};
+
+// local wall time from a cached utc offset, the zone is looked up again only after the offset's validity
+// interval ends (the next dst/rule transition) or after invalidate(), e.g. when /etc/localtime changed
+struct local_clock_t {
+  local_time_of_day_t now() { return time_of_day(std::chrono::system_clock::now()); }
+
+  local_time_of_day_t time_of_day(std::chrono::system_clock::time_point tp) {
+    auto secs = std::chrono::floor<std::chrono::seconds>(tp);
+    if(!valid_ || secs < begin_ || secs >= end_)
+      refresh(secs);
+    int64_t local = (secs + offset_).time_since_epoch().count();
+    int64_t day = ((local % 86400) + 86400) % 86400;
+    return local_time_of_day_t{ static_cast<unsigned>(day / 3600), static_cast<unsigned>(day / 60 % 60), static_cast<unsigned>(day % 60) };
+  }
+
+  void invalidate() {
+    valid_ = false;
+    zone_ = nullptr;
+  }
+
+private:
+  void refresh(date::sys_seconds secs) {
+    if(!zone_)
+      zone_ = date::current_zone();
+    auto info = zone_->get_info(secs);
+    begin_ = info.begin;
+    end_ = info.end;
+    offset_ = info.offset;
+    valid_ = true;
+  }
+
+  const date::time_zone *zone_ = nullptr;
+  date::sys_seconds begin_;
+  date::sys_seconds end_;
+  std::chrono::seconds offset_{ 0 };
+  bool valid_ = false;
+};
+
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace ytk {
+
+// a fixed set of threads running parallel loops, the calling thread takes part so a pool without workers runs inline
+struct worker_pool_t {
+  explicit worker_pool_t(unsigned workers) {
+    for(unsigned i = 0; i < workers; i++)
+      threads_.emplace_back([this] { work(); });
+  }
+
+  worker_pool_t(const worker_pool_t &) = delete;
+  worker_pool_t &operator=(const worker_pool_t &) = delete;
+
+  ~worker_pool_t() {
+    {
+      std::lock_guard<std::mutex> lock{ mutex_ };
+      stop_ = true;
+    }
+    wake_.notify_all();
+    for(auto &t : threads_)
+      t.join();
+  }
+
+  unsigned size() const noexcept { return static_cast<unsigned>(threads_.size()) + 1; }
+
+  // calls func(i) for every i in [0, n) and returns once all of them finished
+  template <class Func> void parallel_for(std::size_t n, Func &&func) {
+    if(threads_.empty() || n <= 1) {
+      for(std::size_t i = 0; i < n; i++)
+        func(i);
+      return;
+    }
+    {
+      std::lock_guard<std::mutex> lock{ mutex_ };
+      job_ = [&func](std::size_t i) { func(i); };
+      n_ = n;
+      next_ = 0;
+      busy_ = threads_.size();
+      generation_++;
+    }
+    wake_.notify_all();
+    drain();
+    std::unique_lock<std::mutex> lock{ mutex_ };
+    done_.wait(lock, [this] { return busy_ == 0; });
+    job_ = nullptr;
+  }
+
+private:
+  void drain() {
+    for(std::size_t i; (i = next_.fetch_add(1)) < n_;)
+      job_(i);
+  }
+
+  void work() {
+    uint64_t seen = 0;
+    for(;;) {
+      {
+        std::unique_lock<std::mutex> lock{ mutex_ };
+        wake_.wait(lock, [&] { return stop_ || generation_ != seen; });
+        if(stop_)
+          return;
+        seen = generation_;
+      }
+      drain();
+      std::lock_guard<std::mutex> lock{ mutex_ };
+      if(--busy_ == 0)
+        done_.notify_one();
+    }
+  }
+
+  std::vector<std::thread> threads_;
+  std::mutex mutex_;
+  std::condition_variable wake_;
+  std::condition_variable done_;
+  std::function<void(std::size_t)> job_;
+  std::size_t n_ = 0;
+  std::atomic<std::size_t> next_ = 0;
+  std::size_t busy_ = 0;
+  uint64_t generation_ = 0;
+  bool stop_ = false;
+};
+
+}
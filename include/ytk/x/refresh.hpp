@@ -0,0 +1,50 @@
+#pragma once
+
+extern "C" {
+
+#include "X11/Xlib.h"
+#include "X11/extensions/Xrandr.h"
+}
+
+#include <algorithm>
+
+namespace ytk::x {
+
+// vertical refresh of a mode in Hz, 0 for modes without timings
+inline double mode_refresh(const XRRModeInfo &mode) {
+  double vtotal = mode.vTotal;
+  if(mode.modeFlags & RR_DoubleScan)
+    vtotal *= 2;
+  if(mode.modeFlags & RR_Interlace)
+    vtotal /= 2;
+  if(!mode.hTotal || !vtotal)
+    return 0;
+  return mode.dotClock / (mode.hTotal * vtotal);
+}
+
+// fastest refresh among the crtcs showing any part of the rectangle (root coordinates), 0 when randr cannot tell
+inline double refresh_rate(Display *disp, Window root, int x, int y, int w, int h) {
+  int event_base, error_base;
+  if(!XRRQueryExtension(disp, &event_base, &error_base))
+    return 0;
+  XRRScreenResources *res = XRRGetScreenResourcesCurrent(disp, root);
+  if(!res)
+    return 0;
+  double hz = 0;
+  for(int i = 0; i < res->ncrtc; i++) {
+    XRRCrtcInfo *crtc = XRRGetCrtcInfo(disp, res, res->crtcs[i]);
+    if(!crtc)
+      continue;
+    bool overlaps = crtc->x < x + w && x < crtc->x + static_cast<int>(crtc->width) && crtc->y < y + h && y < crtc->y + static_cast<int>(crtc->height);
+    if(crtc->mode != None && overlaps) {
+      for(int j = 0; j < res->nmode; j++)
+        if(res->modes[j].id == crtc->mode)
+          hz = std::max(hz, mode_refresh(res->modes[j]));
+    }
+    XRRFreeCrtcInfo(crtc);
+  }
+  XRRFreeScreenResources(res);
+  return hz;
+}
+
+}
@@ -0,0 +1,194 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+extern "C" {
+
+#include <sys/ipc.h>
+#include <sys/shm.h>
+
+#include "X11/Xlib.h"
+#include "X11/Xutil.h"
+#include "X11/extensions/XShm.h"
+}
+
+#include <algorithm>
+#include <vector>
+
+#include "ytk/misc/common.hpp"
+
+namespace ytk::x {
+
+struct shm_image_t;
+
+// per display MIT-SHM state, falls back to plain XPutImage on remote displays or when attaching fails
+struct shm_pool_t {
+  void init(Display *disp) {
+    disp_ = disp;
+    enabled_ = false;
+    completion_type_ = -1;
+    const char *name = DisplayString(disp);
+    bool local = name && (name[0] == ':' || std::strncmp(name, "unix:", 5) == 0);
+    if(local && XShmQueryExtension(disp) && !std::getenv("YTK_NO_SHM")) {
+      enabled_ = true;
+      completion_type_ = XShmGetEventBase(disp) + ShmCompletion;
+    }
+    log::info("ytk.x: mit-shm {}", enabled_ ? "enabled" : "disabled");
+  }
+
+  Display *display() const noexcept { return disp_; }
+  bool enabled() const noexcept { return enabled_; }
+  int completion_type() const noexcept { return completion_type_; }
+
+  // returns true if e was a put completion, which then marks its image as free to draw into
+  inline bool handle_event(const XEvent &e);
+
+private:
+  friend struct shm_image_t;
+
+  inline bool attach(XShmSegmentInfo &info);
+
+  static int attach_error(Display *, XErrorEvent *) {
+    attach_failed_ = true;
+    return 0;
+  }
+
+  static inline bool attach_failed_ = false;
+
+  Display *disp_ = nullptr;
+  bool enabled_ = false;
+  int completion_type_ = -1;
+  std::vector<shm_image_t *> images_;
+};
+
+// a 32bpp ZPixmap image whose pixels live in a shared memory segment when the pool allows it
+struct shm_image_t {
+  shm_image_t() = default;
+  shm_image_t(const shm_image_t &) = delete;
+  shm_image_t &operator=(const shm_image_t &) = delete;
+  ~shm_image_t() { reset(); }
+
+  void create(shm_pool_t &pool, Visual *vis, unsigned depth, unsigned w, unsigned h) {
+    reset();
+    pool_ = &pool;
+    Display *disp = pool.display();
+    if(pool.enabled()) {
+      img_ = XShmCreateImage(disp, vis, depth, ZPixmap, nullptr, &info_, w, h);
+      if(img_) {
+        info_.shmid = shmget(IPC_PRIVATE, img_->bytes_per_line * img_->height, IPC_CREAT | 0600);
+        info_.shmaddr = info_.shmid < 0 ? reinterpret_cast<char *>(-1) : reinterpret_cast<char *>(shmat(info_.shmid, nullptr, 0));
+        if(info_.shmaddr != reinterpret_cast<char *>(-1) && pool.attach(info_)) {
+          img_->data = info_.shmaddr;
+          shared_ = true;
+        } else {
+          if(info_.shmaddr != reinterpret_cast<char *>(-1))
+            shmdt(info_.shmaddr);
+          XDestroyImage(img_);
+          img_ = nullptr;
+        }
+        // the segment goes away once both sides have detached
+        if(info_.shmid >= 0)
+          shmctl(info_.shmid, IPC_RMID, nullptr);
+      }
+      if(!shared_) {
+        log::warn("ytk.x: mit-shm attach failed, using XPutImage");
+        pool.enabled_ = false;
+      }
+    }
+    if(!shared_) {
+      char *data = reinterpret_cast<char *>(std::calloc(static_cast<size_t>(w) * h, 4));
+      img_ = XCreateImage(disp, vis, depth, ZPixmap, 0, data, w, h, 32, 0);
+      if(!img_)
+        raise("ytk.x: cannot create {}x{} image", w, h);
+    }
+    pool.images_.push_back(this);
+  }
+
+  void reset() {
+    if(!img_)
+      return;
+    if(shared_) {
+      // the server keeps its own mapping until it processes the detach, so pending puts stay valid
+      XShmDetach(pool_->display(), &info_);
+      img_->data = nullptr;
+      XDestroyImage(img_);
+      shmdt(info_.shmaddr);
+    } else {
+      XDestroyImage(img_);
+    }
+    auto &imgs = pool_->images_;
+    imgs.erase(std::remove(imgs.begin(), imgs.end(), this), imgs.end());
+    img_ = nullptr;
+    shared_ = false;
+    busy_ = false;
+  }
+
+  explicit operator bool() const noexcept { return img_ != nullptr; }
+  bool shared() const noexcept { return shared_; }
+  unsigned width() const noexcept { return img_ ? img_->width : 0; }
+  unsigned height() const noexcept { return img_ ? img_->height : 0; }
+  int stride() const noexcept { return img_->bytes_per_line; }
+  uint8_t *data() noexcept { return reinterpret_cast<uint8_t *>(img_->data); }
+  XImage *ximage() noexcept { return img_; }
+
+  void clear() { std::memset(img_->data, 0, static_cast<size_t>(img_->bytes_per_line) * img_->height); }
+
+  void put(Drawable draw, GC gc, int src_x, int src_y, int dst_x, int dst_y, unsigned w, unsigned h) {
+    Display *disp = pool_->display();
+    if(shared_) {
+      last_put_ = NextRequest(disp);
+      XShmPutImage(disp, draw, gc, img_, src_x, src_y, dst_x, dst_y, w, h, True);
+      busy_ = true;
+    } else {
+      XPutImage(disp, draw, gc, img_, src_x, src_y, dst_x, dst_y, w, h);
+    }
+  }
+
+  // true while the server may still be reading the segment
+  bool busy() const noexcept { return busy_; }
+
+  // blocks until the last put has been consumed, call before drawing into the pixels again
+  void wait() {
+    if(!busy_)
+      return;
+    XSync(pool_->display(), False);
+    busy_ = false;
+  }
+
+private:
+  friend struct shm_pool_t;
+
+  shm_pool_t *pool_ = nullptr;
+  XImage *img_ = nullptr;
+  XShmSegmentInfo info_{};
+  bool shared_ = false;
+  bool busy_ = false;
+  unsigned long last_put_ = 0;
+};
+
+bool shm_pool_t::handle_event(const XEvent &e) {
+  if(completion_type_ < 0 || e.type != completion_type_)
+    return false;
+  const auto &ce = reinterpret_cast<const XShmCompletionEvent &>(e);
+  for(auto *img : images_) {
+    // completions of earlier puts must not release an image that has been put again since
+    if(img->shared_ && img->info_.shmseg == ce.shmseg && ce.serial >= img->last_put_)
+      img->busy_ = false;
+  }
+  return true;
+}
+
+bool shm_pool_t::attach(XShmSegmentInfo &info) {
+  info.readOnly = False;
+  attach_failed_ = false;
+  XSync(disp_, False);
+  auto prev = XSetErrorHandler(attach_error);
+  bool ok = XShmAttach(disp_, &info);
+  XSync(disp_, False);
+  XSetErrorHandler(prev);
+  return ok && !attach_failed_;
+}
+
+}
@@ -9,9 +9,19 @@ extern "C" {
 #include "X11/Xutil.h"
 }
 
+#include <poll.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
 #include <memory>
 
+#include "ytk/event/event_types.hpp"
+#include "ytk/event/registry.hpp"
 #include "ytk/misc/common.hpp"
+#include "ytk/misc/frame_clock.hpp"
+#include "ytk/x/refresh.hpp"
+#include "ytk/x/shm.hpp"
 
 #include "agg_basics.h"
 #include "agg_pixfmt_rgb.h"
@@ -64,8 +74,8 @@ public:
     XSetWMProtocols(disp_, win_, &WM_DELETE_WINDOW, 1);
 
     gc_ = XCreateGC(disp_, win_, 0, nullptr);
-    pix_data_.resize(width_ * height_ * 4);
-    img_ = XCreateImage(disp_, vis_, depth_, ZPixmap, 0, reinterpret_cast<char *>(pix_data_.data()), width_, height_, 32, 0);
+    shm_.init(disp_);
+    img_.create(shm_, vis_, depth_, width_, height_);
 
     XMapWindow(disp_, win_);
   }
@@ -73,8 +83,7 @@ public:
   void close() {
     if(disp_) {
       XUnmapWindow(disp_, win_);
-      img_->data = nullptr;
-      XDestroyImage(img_);
+      img_.reset();
       XFreeGC(disp_, gc_);
       XDestroyWindow(disp_, win_);
       XCloseDisplay(disp_);
@@ -87,17 +96,38 @@ public:
 
   void set_size(unsigned w, unsigned h) { XResizeWindow(disp_, win_, w, h); }
 
+  // refresh of the outputs the window is on, paces a frame clock for it
+  double refresh_rate() const {
+    Window root = DefaultRootWindow(disp_);
+    Window child;
+    int x, y;
+    XTranslateCoordinates(disp_, win_, root, 0, 0, &x, &y, &child);
+    return ytk::x::refresh_rate(disp_, root, x, y, width_, height_);
+  }
+
+  // the clock event::frame_t counts in, seconds
+  static double steady_now() { return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count(); }
+
+  // while on, process_event() also hands out event::frame_t at the refresh rate of the outputs under the window.
+  // meant to follow a frame_clock_t's active(), off it never wakes up for frames
+  void set_animating(bool on) {
+    if(on == (frame_interval_ > 0))
+      return;
+    frame_interval_ = on ? frame_clock_t<int>::interval(refresh_rate()) : 0;
+    next_frame_ = steady_now() + frame_interval_;
+  }
+
   template <class Callable> void redraw_xwin(Callable func) { func(disp_, win_, gc_, width_, height_, depth_); }
 
   template <class Callable> void redraw(Callable func) {
-    pix_data_.resize(width_ * height_ * 4);
-    std::fill(pix_data_.begin(), pix_data_.end(), 0);
-    img_->width = width_;
-    img_->bytes_per_line = width_ * 4;
-    img_->height = height_;
-    img_->data = reinterpret_cast<char *>(pix_data_.data());
-
-    agg::rendering_buffer rbuf{ pix_data_.data(), width_, height_, static_cast<int>(width_ * 4) };
+    if(img_.width() != width_ || img_.height() != height_) {
+      img_.create(shm_, vis_, depth_, width_, height_);
+    } else {
+      img_.wait();
+      img_.clear();
+    }
+
+    agg::rendering_buffer rbuf{ img_.data(), width_, height_, img_.stride() };
     switch(depth_) {
     case 24: {
       agg::pixfmt_bgrx32 pix{ rbuf };
@@ -110,14 +140,31 @@ public:
     default:
       raise("invalid depth");
     }
-    XPutImage(disp_, win_, gc_, img_, 0, 0, 0, 0, width_, height_);
+    img_.put(win_, gc_, 0, 0, 0, 0, width_, height_);
   }
 
   void process_event(bool block = false) {
+    // X events go first, a due frame is handed out once none is queued
+    if(frame_interval_ > 0 && !XPending(disp_)) {
+      double now = steady_now();
+      if(now >= next_frame_) {
+        next_frame_ = std::max(next_frame_ + frame_interval_, now);
+        event::handle(event::frame_t{ now });
+        return;
+      }
+      if(!block)
+        return;
+      pollfd pfd{ ConnectionNumber(disp_), POLLIN, 0 };
+      ::poll(&pfd, 1, static_cast<int>(std::ceil((next_frame_ - now) * 1000)));
+      if(!XPending(disp_))
+        return;
+    }
     if(!block && !XPending(disp_))
       return;
     XEvent e;
     XNextEvent(disp_, &e);
+    if(shm_.handle_event(e))
+      return;
     // handle event
     switch(e.type) {
     case Expose: {
@@ -151,14 +198,17 @@ private:
   int depth_ = 0;
 
   Visual *vis_ = nullptr;
-  XImage *img_ = nullptr;
-  std::vector<uint8_t> pix_data_;
+  shm_pool_t shm_;
+  shm_image_t img_;
 
   Atom WM_PROTOCOLS;
   Atom WM_DELETE_WINDOW;
 
   unsigned width_ = 800;
   unsigned height_ = 600;
+
+  double frame_interval_ = 0; // seconds between frames, 0 while not animating
+  double next_frame_ = 0;
 };
 
 }
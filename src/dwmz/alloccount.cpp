@@ -0,0 +1,34 @@
+#ifdef DWMZ_COUNT_ALLOCS
+
+#include <cstdlib>
+#include <new>
+
+#include "ytk/misc/alloc_counter.hpp"
+
+/* debug builds count every operator new per thread so steady state bar frames can assert they never allocate */
+
+void *operator new(std::size_t size) {
+  ytk::thread_allocs()++;
+  if(void *p = std::malloc(size ? size : 1))
+    return p;
+  throw std::bad_alloc();
+}
+
+void *operator new(std::size_t size, std::align_val_t align) {
+  ytk::thread_allocs()++;
+  std::size_t a = static_cast<std::size_t>(align);
+  std::size_t n = size ? (size + a - 1) / a * a : a;
+  if(void *p = std::aligned_alloc(a, n))
+    return p;
+  throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept { std::free(p); }
+
+void operator delete(void *p, std::size_t) noexcept { std::free(p); }
+
+void operator delete(void *p, std::align_val_t) noexcept { std::free(p); }
+
+void operator delete(void *p, std::size_t, std::align_val_t) noexcept { std::free(p); }
+
+#endif
@@ -20,7 +20,10 @@ Drw *drw_create(Display *dpy, int screen, Window root, Visual *visual, unsigned
   drw->depth = depth;
   drw->cmap = cmap;
   Pixmap pm = XCreatePixmap(dpy, root, 1, 1, depth);
-  drw->gc = XCreateGC(dpy, pm, 0, NULL);
+  /* bar uploads XCopyArea with it, nobody wants the NoExpose that would follow each copy */
+  XGCValues gcv;
+  gcv.graphics_exposures = False;
+  drw->gc = XCreateGC(dpy, pm, GCGraphicsExposures, &gcv);
   XFreePixmap(dpy, pm);
   return drw;
 }
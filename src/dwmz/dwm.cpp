@@ -22,13 +22,24 @@
  */
 
 #include "bar/gc/colorscheme.hpp"
+#include "bar/gc/display_list.hpp"
 #include "bar/gc/gc.hpp"
-#include "bar/layout/wmbar.hpp"
+#include "bar/gc/xrender.hpp"
+#include "bar/layout/row.hpp"
 #include "bar/layout/zone.hpp"
 
 #include "setbg/png_lanczos.hpp"
+#include "ytk/misc/alloc_counter.hpp"
+#include "ytk/misc/frame_arena.hpp"
+#include "ytk/misc/frame_clock.hpp"
+#include "ytk/misc/local_clock.hpp"
+#include "ytk/misc/worker_pool.hpp"
+#include "ytk/x/refresh.hpp"
+#include "ytk/x/shm.hpp"
 #include <X11/X.h>
 #include <X11/extensions/Xrender.h>
+#include <X11/extensions/dpms.h>
+#include <X11/extensions/scrnsaver.h>
 
 #ifndef DWMZ_NO_FCITX
 #include "fcitxim/fcitxim.hpp"
@@ -52,9 +63,15 @@
 #include "date/date.h"
 #include "date/tz.h"
 
+#include <algorithm>
+#include <atomic>
+#include <cassert>
 #include <chrono>
+#include <condition_variable>
 #include <cstdlib>
 #include <map>
+#include <mutex>
+#include <thread>
 
 #include <X11/XKBlib.h>
 #include <X11/Xatom.h>
@@ -86,7 +103,8 @@
 #define INTERSECT(x, y, w, h, m)                                                                                                                              \
   (DWM_MAX(0, DWM_MIN((x) + (w), (m)->wx + (m)->ww) - DWM_MAX((x), (m)->wx)) * DWM_MAX(0, DWM_MIN((y) + (h), (m)->wy + (m)->wh) - DWM_MAX((y), (m)->wy)))
 #define ISVISIBLE(C) ((C->tags & C->mon->tagset[C->mon->seltags]))
-#define HIDDEN(C) ((getstate(C->win) == IconicState))
+#define INBAR(C) (ISVISIBLE(C) && C->mon->barvis)
+#define HIDDEN(C) ((C)->wmstate == IconicState)
 #define LENGTH(X) (sizeof X / sizeof X[0])
 #define MOUSEMASK (BUTTONMASK | PointerMotionMask)
 #define WIDTH(X) ((X)->w + 2 * (X)->bw + gappx)
@@ -111,6 +129,8 @@ enum {
 };                                                                                              /* EWMH atoms */
 enum { WMProtocols, WMDelete, WMState, WMTakeFocus, WMLast };                                   /* default atoms */
 enum { ClkTagBar, ClkLtSymbol, ClkStatusText, ClkWinTitle, ClkClientWin, ClkRootWin, ClkLast }; /* clicks */
+enum { DeferArrange = 1 << 0, DeferRestack = 1 << 1, DeferBar = 1 << 2 };                         /* deferred work */
+enum { SrcWm = 1 << 0, SrcTime = 1 << 1, SrcStatus = 1 << 2, SrcVolume = 1 << 3, SrcIm = 1 << 4 }; /* bar widget inputs */
 
 typedef union {
   int i;
@@ -131,6 +151,8 @@ typedef struct Monitor Monitor;
 typedef struct Client Client;
 struct Client {
   char name[256];
+  int titledirty;   /* name changed, fetched once the title shows in the bar */
+  double titletime; /* loop time name was last fetched */
   float mina, maxa;
   int x, y, w, h;
   int oldx, oldy, oldw, oldh;
@@ -138,6 +160,7 @@ struct Client {
   int bw, oldbw;
   unsigned int tags;
   int isfixed, isfloating, isurgent, neverfocus, oldstate, isfullscreen;
+  long wmstate; /* WM_STATE as last set by setclientstate, HIDDEN reads it without a round trip */
   Client *next;
   Client *snext;
   Monitor *mon;
@@ -158,6 +181,26 @@ typedef struct {
 
 static bar::zone_attr_t barattr;
 
+/* what one monitor's bar holds of a widget */
+typedef struct {
+  bar::zone_t z;
+  bar::zone_snapshot_t key;  /* inputs it was last recorded from */
+  bar::zone_snapshot_t snap; /* display list it was last rendered from */
+  std::vector<std::pair<bar::zone_t, Arg>> clickarg;
+  double goal;  /* where an animated widget is heading */
+  double value; /* what an animated widget shows in this frame */
+} WidgetState;
+
+typedef struct {
+  bar::row_edge_t edge;                               /* end of the bar it packs against, fill widgets share the middle */
+  double width;                                       /* in bar heights, unused for fill widgets */
+  unsigned int sources;                               /* Src* inputs that can change what it shows */
+  double period;                                      /* seconds between SrcTime redraws on wall clock boundaries, 0 for none */
+  void (*key)(Monitor *m, WidgetState &w);           /* adds everything it shows to w.key, it is recorded only when that changed */
+  void (*record)(Monitor *m, WidgetState &w);
+  unsigned int click;
+} Widget;
+
 struct Monitor {
   bar::ltbutton_icon_t lticon;
   float mfact;
@@ -177,16 +220,36 @@ struct Monitor {
   Client *stack;
   Monitor *next;
 
+  unsigned int deferred; /* Defer* work requested since the last flush */
+
   Window barwin;
-  XImage barimg;
-  bar::wmbar_layout_t barlayo;
-  std::vector<uint8_t> bardata;
-  std::vector<std::pair<bar::zone_t, unsigned int>> barclick;
-  std::vector<std::pair<bar::zone_t, Arg>> barclickarg;
+  int barobscured; /* VisibilityNotify says none of barwin shows */
+  int barvis;      /* whether the last flush found the bar visible, nothing is recorded for it otherwise */
+  ytk::x::shm_image_t barimg[2]; /* front and back frame, the render thread draws into barimg[barback] */
+  int barback;
+  Pixmap barpm;
+  Picture barpict; /* on barpm, only with the XRender backend */
+  double refresh;  /* Hz of the outputs under the monitor, paces the frame clock */
+  bar::backdrop_t bardrop; /* blurred wallpaper under the bar that frames start from, empty for transparent */
+  Picture bardroppict;     /* bardrop in the server, only with the XRender backend */
+  std::vector<WidgetState> barwidgets; /* one per widgets[] entry */
+  unsigned int bardirty;               /* bit i set when widgets[i] is due for recording */
 
   const Layout *lt[2];
 };
 
+/* a changed bar zone waiting to be rendered, and the strips it is cut into */
+struct BarJob {
+  Monitor *m;
+  bar::zone_t z;
+  bar::display_list_view_t list; /* lives in the arena of the frame the job is queued in */
+};
+
+struct BarTile {
+  size_t job;
+  bar::zone_t z;
+};
+
 typedef struct {
   const char *klass;
   const char *instance;
@@ -209,6 +272,7 @@ static void applyrules(Client *c);
 static int applysizehints(Client *c, int *x, int *y, int *w, int *h, int interact);
 static void arrange(Monitor *m);
 static void arrangemon(Monitor *m);
+static void flushdeferred(void);
 static void attach(Client *c);
 static void attachstack(Client *c);
 static void buttonpress(XEvent *e);
@@ -225,8 +289,22 @@ static void detach(Client *c);
 static void detachstack(Client *c);
 static Monitor *dirtomon(int dir);
 static void drawbar(Monitor *m);
+static void markbar(Monitor *m, unsigned int src);
+static void markbars(unsigned int src);
+static void recordbar(Monitor *m);
+static void recorddue(void);
+static void animatebar(Monitor *m, unsigned int i, double from, double to);
+static double frameinterval(void);
 static void drawbars(void);
+static void drainxevent(void);
 static void expose(XEvent *e);
+static int barvisible(Monitor *m);
+static void updatebarvis(void);
+static void pollscreen(void);
+static void timerdpms(ev::timer &w, int revents);
+static void screensavernotify(XEvent *e);
+static void visibilitynotify(XEvent *e);
+static void shmcompletion(XEvent *e);
 static void focus(Client *c);
 static void focusin(XEvent *e);
 static void focusmon(const Arg *arg);
@@ -258,6 +336,7 @@ static void resize(Client *c, int x, int y, int w, int h, int interact);
 static void resizeclient(Client *c, int x, int y, int w, int h);
 static void resizemouse(const Arg *arg);
 static void restack(Monitor *m);
+static void restacknow(Monitor *m);
 static void run(void);
 static void scan(void);
 static int sendevent(Client *c, Atom proto);
@@ -275,9 +354,11 @@ static void showwin(Client *c);
 static void showhide(Client *c);
 static void spawn(const Arg *arg);
 static void spawncmdptr(const Arg *arg);
+static void syncbars(void);
 static void tag(const Arg *arg);
 static void tagmon(const Arg *arg);
 static void tile(Monitor *m);
+static void timertitles(ev::timer &w, int revents);
 static void togglebar(const Arg *arg);
 static void togglefloating(const Arg *arg);
 static void toggletag(const Arg *arg);
@@ -290,13 +371,16 @@ static void unmapnotify(XEvent *e);
 static void updatebarpos(Monitor *m);
 static void updatebars(void);
 static void updatebg(Monitor *m);
+static void updatebardrop(Monitor *m, ytk::x::shm_image_t &wall);
 static void updatebgs(void);
 static void updateclientlist(void);
+static void updateclientlistnow(void);
 static int updategeom(void);
 static void updatenumlockmask(void);
 static void updatesizehints(Client *c);
 static void updatestatus(void);
 static void updatetitle(Client *c);
+static void scheduletitle(Client *c);
 static void updatewindowtype(Client *c);
 static void updatewmhints(Client *c);
 static void view(const Arg *arg);
@@ -306,6 +390,7 @@ static int xerror(Display *dpy, XErrorEvent *ee);
 static int xerrordummy(Display *dpy, XErrorEvent *ee);
 static int xerrorstart(Display *dpy, XErrorEvent *ee);
 static void xinitvisual();
+static void xinitscreensaver(void);
 static void zoom(const Arg *arg);
 
 /* variables */
@@ -327,7 +412,8 @@ static std::map<int, void (*)(XEvent *)> handler{ { ButtonPress, buttonpress },
                                                   { MappingNotify, mappingnotify },
                                                   { MapRequest, maprequest },
                                                   { PropertyNotify, propertynotify },
-                                                  { UnmapNotify, unmapnotify } };
+                                                  { UnmapNotify, unmapnotify },
+                                                  { VisibilityNotify, visibilitynotify } };
 static Atom wmatom[WMLast], netatom[NetLast];
 static Cur *cursor[CurLast];
 static Display *dpy;
@@ -335,6 +421,51 @@ static Drw *drw;
 static Monitor *mons, *selmon;
 static Window root, wmcheckwin;
 static Pixmap bg_pm;
+static ytk::x::shm_pool_t shmpool;
+static bar::recording_gc_t barrec;
+static std::unique_ptr<ytk::worker_pool_t> barpool;
+static ev::async a_barframe;
+static ev::async a_drawbars;
+static std::atomic<unsigned int> asyncsrc; /* Src* raised by service threads, folded in by asyncdrawbars */
+static ytk::local_clock_t localclock;
+static int clientlistdirty;
+static int dpmsext;   /* DPMS is there to be polled */
+static int screenoff; /* DPMS has the outputs in standby, suspend or off */
+static int saveron;   /* the MIT-SCREEN-SAVER screen saver (or a locker driven by it) is up */
+static ev::timer dpmstimer;
+static int widgetsarmed; /* run() has set up widgettimers, updatebarvis may start and stop them */
+static ev::timer titletimer;
+static ytk::frame_clock_t<std::pair<Monitor *, unsigned int>> frameclock; /* animating widgets, as monitor and widgets[] index */
+static ev::timer frametimer;                                              /* runs only while frameclock is active */
+static void timerframe(ev::timer &, int);
+static void keystatus(Monitor *m, WidgetState &w);
+static void recordstatus(Monitor *m, WidgetState &w);
+static void keytags(Monitor *m, WidgetState &w);
+static void recordtags(Monitor *m, WidgetState &w);
+static void keyltbutton(Monitor *m, WidgetState &w);
+static void recordltbutton(Monitor *m, WidgetState &w);
+static void keywins(Monitor *m, WidgetState &w);
+static void recordwins(Monitor *m, WidgetState &w);
+static void keyclock(Monitor *m, WidgetState &w);
+static void recordclock(Monitor *m, WidgetState &w);
+#ifndef DWMZ_NO_WP
+static void keyvolume(Monitor *m, WidgetState &w);
+static void recordvolume(Monitor *m, WidgetState &w);
+#endif
+#ifndef DWMZ_NO_FCITX
+static void keyim(Monitor *m, WidgetState &w);
+static void recordim(Monitor *m, WidgetState &w);
+#endif
+static std::vector<BarTile> bartiles;
+/* recorded frames go event loop -> render thread -> event loop for upload */
+static std::thread barthread;
+static std::mutex barmutex;
+static std::condition_variable barcond;
+static std::vector<BarJob> barpending; /* recorded, a newer snapshot of a zone replaces the pending one */
+static std::vector<BarJob> barframe;   /* being rendered or waiting for upload */
+static std::unique_ptr<bar::xrender_gc_t> barxr; /* set when bars are drawn server side, there is no render thread then */
+static ytk::frame_arena_t barpendingarena, barframearena; /* swapped along with the queues, reset once a frame is uploaded */
+static bool barrendering, barframeready, barquit;
 static GC root_gc;
 
 static int useargb = 0;
@@ -355,6 +486,17 @@ static const int showbar = 1;           /* 0 means no bar */
 static const int topbar = 1;            /* 0 means bottom bar */
 static const int focusonwheel = 0;
 static const double bh_ratio = 0.03;
+static const int clockseconds = 1; /* 0 shows hh:mm and wakes on minute boundaries only */
+static const double dpmspoll = 2.;   /* seconds between DPMS state polls, the bar lags a screen waking by at most this */
+static const unsigned int barworkers = 3; /* threads helping to render the bars, capped by the cores */
+static const int bartile = 512;           /* widest strip of a bar zone one worker renders */
+static const double titlerate = 0.2;      /* seconds between title refetches of one client */
+static const int barxrender = 0;          /* 1 composites bar text and panels in the server through XRender glyph sets */
+static const double animduration = 0.15;  /* seconds a bar animation runs, 0 disables them */
+static const int barfrost = 1;            /* 1 lays the bars over a blurred, tinted copy of the wallpaper instead of plain transparency */
+static const double barfrostblur = 0.3;   /* blur radius in bar heights */
+static const bar::rgb_literal_t barfrosttint = bar::colors::kanagawa::sumiInk1;
+static const uint8_t barfrostalpha = 128; /* how far the blurred wallpaper is pulled towards barfrosttint */
 
 bar::rgb_literal_t active_rgb = bar::colors::kanagawa::waveBlue2;
 uint8_t active_alpha = 255;
@@ -385,6 +527,24 @@ static const Layout layouts[] = {
   { bar::ltbutton_icon_t::monocle, monocle },
 };
 
+/* bar widgets, left and right ones pack inwards from their end in table order, the fill one takes what is left */
+static const Widget widgets[] = {
+  /* edge   width (bar heights)   sources   period (s)   key   record   click */
+  { bar::row_edge_t::left, 3, SrcStatus, 0, keystatus, recordstatus, ClkStatusText },
+  { bar::row_edge_t::left, 1.2 * LENGTH(tags), SrcWm, 0, keytags, recordtags, ClkTagBar },
+  { bar::row_edge_t::left, 1.2, SrcWm, 0, keyltbutton, recordltbutton, ClkLtSymbol },
+  { bar::row_edge_t::fill, 0, SrcWm, 0, keywins, recordwins, ClkWinTitle },
+  { bar::row_edge_t::right, 4, SrcTime, clockseconds ? 1. : 60., keyclock, recordclock, ClkRootWin },
+#ifndef DWMZ_NO_WP
+  { bar::row_edge_t::right, 2.5, SrcVolume, 0, keyvolume, recordvolume, ClkRootWin },
+#endif
+#ifndef DWMZ_NO_FCITX
+  { bar::row_edge_t::right, 1.2, SrcIm, 0, keyim, recordim, ClkRootWin },
+#endif
+};
+static_assert(LENGTH(widgets) <= 32, "bardirty has a bit per widget");
+static ev::periodic widgettimers[LENGTH(widgets)];
+
 /* key definitions */
 #define MODKEY Mod1Mask
 // clang-format off
@@ -606,18 +766,16 @@ int applysizehints(Client *c, int *x, int *y, int *w, int *h, int interact) {
   return *x != c->x || *y != c->y || *w != c->w || *h != c->h;
 }
 
+/* only requested here, flushdeferred() lays out each monitor once per loop iteration and redraws its bar (lticon) */
 void arrange(Monitor *m) {
-  if(m)
-    showhide(m->stack);
-  else
-    for(m = mons; m; m = m->next)
-      showhide(m->stack);
   if(m) {
-    arrangemon(m);
-    restack(m);
+    m->deferred |= DeferArrange | DeferRestack;
+    drawbar(m);
   } else
-    for(m = mons; m; m = m->next)
-      arrangemon(m);
+    for(m = mons; m; m = m->next) {
+      m->deferred |= DeferArrange;
+      drawbar(m);
+    }
 }
 
 void arrangemon(Monitor *m) {
@@ -653,18 +811,21 @@ void buttonpress(XEvent *e) {
     focus(NULL);
   }
   if(ev->window == selmon->barwin) {
-    for(const auto &[z, zclick] : m->barclick) {
-      if(hittest(z, ev->x, ev->y)) {
-        click = zclick;
-        break;
-      }
-    }
-
-    for(const auto &[z, zarg] : m->barclickarg) {
-      if(hittest(z, ev->x, ev->y)) {
-        arg = zarg;
-        break;
+    for(i = 0; i < LENGTH(widgets); i++) {
+      const WidgetState &w = m->barwidgets[i];
+      if(!hittest(w.z, ev->x, ev->y))
+        continue;
+      /* tags and titles only take clicks that land on an item, anywhere else (or no item at all) is the root */
+      if(widgets[i].click != ClkTagBar && widgets[i].click != ClkWinTitle)
+        click = widgets[i].click;
+      for(const auto &[z, zarg] : w.clickarg) {
+        if(hittest(z, ev->x, ev->y)) {
+          click = widgets[i].click;
+          arg = zarg;
+          break;
+        }
       }
+      break;
     }
   } else if((c = wintoclient(ev->window))) {
     if(focusonwheel || (ev->button != Button4 && ev->button != Button5))
@@ -698,8 +859,17 @@ void cleanup(void) {
     while(m->stack)
       unmanage(m->stack, 0);
   XUngrabKey(dpy, AnyKey, AnyModifier, root);
+  syncbars();
+  {
+    std::lock_guard<std::mutex> lock{ barmutex };
+    barquit = true;
+  }
+  barcond.notify_all();
+  if(barthread.joinable())
+    barthread.join();
   while(mons)
     cleanupmon(mons);
+  barxr.reset();
   for(i = 0; i < CurLast; i++)
     drw_cur_free(drw, cursor[i]);
   XDestroyWindow(dpy, wmcheckwin);
@@ -721,8 +891,16 @@ void cleanupmon(Monitor *mon) {
       ;
     m->next = mon->next;
   }
+  syncbars();
+  frameclock.cancel_if([mon](const std::pair<Monitor *, unsigned int> &t) { return t.first == mon; });
   XUnmapWindow(dpy, mon->barwin);
   XDestroyWindow(dpy, mon->barwin);
+  if(mon->barpict)
+    XRenderFreePicture(dpy, mon->barpict);
+  if(mon->bardroppict)
+    XRenderFreePicture(dpy, mon->bardroppict);
+  if(mon->barpm)
+    XFreePixmap(dpy, mon->barpm);
   delete mon;
 }
 
@@ -837,12 +1015,13 @@ void configurerequest(XEvent *e) {
 Monitor *createmon(void) {
   Monitor *m;
 
-  m = new Monitor;
-  memset(m, 0, sizeof(Monitor));
+  /* value-initialized, the bar members hold std::string and must not be memset */
+  m = new Monitor();
   m->tagset[0] = m->tagset[1] = 1;
   m->mfact = mfact;
   m->nmaster = nmaster;
   m->showbar = showbar;
+  m->barwidgets.resize(LENGTH(widgets));
   m->topbar = topbar;
   m->lt[0] = &layouts[0];
   m->lt[1] = &layouts[1 % LENGTH(layouts)];
@@ -895,130 +1074,471 @@ Monitor *dirtomon(int dir) {
   return m;
 }
 
-void drawbar(Monitor *m) {
-  int x, w, tw = 0, n = 0, scm;
-  unsigned int i, occ = 0, urg = 0;
-  Client *c;
+/* diffs the display list recorded for z against the last frame and hands it to the render thread if it changed */
+static void flushbarzone(Monitor *m, bar::zone_snapshot_t &snap, const bar::zone_t &z) {
+  barrec.snapshot(snap);
+  if(snap.commit() && z.w > 0) {
+    std::lock_guard<std::mutex> lock{ barmutex };
+    auto it = std::find_if(barpending.begin(), barpending.end(), [&](const BarJob &j) { return j.m == m && j.z.x == z.x && j.z.w == z.w; });
+    if(it == barpending.end())
+      it = barpending.insert(barpending.end(), BarJob{ m, z, {} });
+    it->list = barrec.copy_to(barpendingarena);
+  }
+  barrec.clear();
+}
+
+/* replays the frame into the back images in tiles. every zone is cleared and redrawn whole and only these zones are
+   uploaded, so pixels the back image missed from the last upload are never read */
+static void renderbarframe(void) {
+  bartiles.clear();
+  for(size_t j = 0; j < barframe.size(); j++) {
+    const bar::zone_t &z = barframe[j].z;
+    for(double x = z.x; x < z.x + z.w; x += bartile)
+      bartiles.push_back({ j, { x, z.y, std::min<double>(bartile, z.x + z.w - x), z.h } });
+  }
+  barpool->parallel_for(bartiles.size(), [](size_t i) {
+    /* one gc per thread, its rasterizer, scanline and span buffers keep their memory from frame to frame */
+    static thread_local agg::rendering_buffer rbuf;
+    static thread_local agg::pixfmt_bgra32 pix{ rbuf };
+    static thread_local bar::agg_gc_t gc{ pix };
+    const BarTile &tile = bartiles[i];
+    const BarJob &job = barframe[tile.job];
+    ytk::x::shm_image_t &img = job.m->barimg[job.m->barback];
+    rbuf.attach(img.data(), img.width(), img.height(), img.stride());
+    gc.begin_zone(tile.z, job.m->bardrop);
+    job.list.replay(gc);
+    gc.end_zone();
+  });
+}
+
+static void barrenderloop(void) {
+  std::unique_lock<std::mutex> lock{ barmutex };
+  for(;;) {
+    barcond.wait(lock, [] { return barquit || (!barpending.empty() && !barframeready); });
+    if(barquit)
+      return;
+    std::swap(barframe, barpending);
+    std::swap(barframearena, barpendingarena);
+    barrendering = true;
+    lock.unlock();
+    renderbarframe();
+    lock.lock();
+    barrendering = false;
+    barframeready = true;
+    a_barframe.send();
+    barcond.notify_all();
+  }
+}
+
+/* uploads a finished frame and flips the monitors it touched, barpm always holds the last frame so expose never has to render.
+   the render thread leaves barframe and the back images alone while barframeready is set, so barmutex is only taken
+   to hand the frame back and never across the server round trips */
+static void uploadbarframe(void) {
+  {
+    std::lock_guard<std::mutex> lock{ barmutex };
+    if(!barframeready)
+      return;
+  }
+  for(Monitor *m = mons; m; m = m->next) {
+    int touched = 0;
+    for(const auto &job : barframe) {
+      if(job.m != m)
+        continue;
+      const bar::zone_t &z = job.z;
+      m->barimg[m->barback].put(m->barpm, drw->gc, z.x, z.y, z.x, z.y, z.w, z.h);
+      XCopyArea(dpy, m->barpm, m->barwin, drw->gc, z.x, z.y, z.w, z.h, z.x, z.y);
+      touched = 1;
+    }
+    if(!touched)
+      continue;
+    m->barback = !m->barback;
+    /* the render thread may only draw into the new back frame once the server has read it */
+    m->barimg[m->barback].wait();
+  }
+  XFlush(dpy);
+  std::lock_guard<std::mutex> lock{ barmutex };
+  barframe.clear();
+  barframearena.reset();
+  barframeready = false;
+  barcond.notify_all();
+}
+
+/* waits out the render thread and drops every queued frame, the bars are redrawn in full afterwards */
+static void syncbars(void) {
+  std::unique_lock<std::mutex> lock{ barmutex };
+  barcond.wait(lock, [] { return !barrendering; });
+  barpending.clear();
+  barframe.clear();
+  barpendingarena.reset();
+  barframearena.reset();
+  barframeready = false;
+  for(Monitor *m = mons; m; m = m->next) {
+    for(auto &w : m->barwidgets) {
+      w.key.invalidate();
+      w.snap.invalidate();
+    }
+    markbar(m, ~0u);
+  }
+}
+
+/* with the XRender backend recorded zones go straight to the server, only glyph indices and rectangles cross the wire */
+static void drawbarsxrender(void) {
+  std::lock_guard<std::mutex> lock{ barmutex };
+  for(const auto &job : barpending) {
+    Monitor *m = job.m;
+    const bar::zone_t &z = job.z;
+    barxr->target(m->barpict);
+    barxr->begin_zone(z, m->bardroppict);
+    job.list.replay(*barxr);
+    barxr->end_zone();
+    XCopyArea(dpy, m->barpm, m->barwin, drw->gc, z.x, z.y, z.w, z.h, z.x, z.y);
+  }
+  barpending.clear();
+  barpendingarena.reset();
+}
+
+static void submitbars(void) {
+  if(barxr)
+    return drawbarsxrender();
+  std::lock_guard<std::mutex> lock{ barmutex };
+  if(!barpending.empty())
+    barcond.notify_all();
+}
+
+void drawbar(Monitor *m) { markbar(m, SrcWm); }
+
+/* queues the widgets of m reading any of src for the next flush */
+void markbar(Monitor *m, unsigned int src) {
+  unsigned int i;
+
+  for(i = 0; i < LENGTH(widgets); i++)
+    if(widgets[i].sources & src)
+      m->bardirty |= 1u << i;
+  if(m->bardirty)
+    m->deferred |= DeferBar;
+}
+
+void markbars(unsigned int src) {
+  Monitor *m;
+
+  for(m = mons; m; m = m->next)
+    markbar(m, src);
+}
 
-  if(!m->showbar)
+/* records the due widgets whose key changed, the others keep what barpm already shows */
+void recordbar(Monitor *m) {
+  unsigned int i;
+
+  if(!m->barvis)
     return;
+  for(i = 0; i < LENGTH(widgets); i++) {
+    WidgetState &w = m->barwidgets[i];
+    if(!(m->bardirty & (1u << i)))
+      continue;
+    widgets[i].key(m, w);
+    if(!w.key.commit())
+      continue;
+    w.clickarg.clear();
+    widgets[i].record(m, w);
+    flushbarzone(m, w.snap, w.z);
+  }
+  m->bardirty = 0;
+}
 
-  std::fill(m->bardata.begin(), m->bardata.end(), 0);
-  m->barclick.clear();
-  m->barclickarg.clear();
+/* records what bardirty holds right away, monitors with deferred work record it along with that once their layout settled */
+void recorddue(void) {
+  Monitor *m;
 
-  agg::rendering_buffer rbuf{ m->bardata.data(), (unsigned)m->ww, (unsigned)bh, m->ww * 4 };
+  for(m = mons; m; m = m->next) {
+    if(!m->bardirty)
+      continue;
+    if(m->deferred)
+      m->deferred |= DeferBar;
+    else
+      recordbar(m);
+  }
+  submitbars();
+}
 
-  agg::pixfmt_bgra32 pix{ rbuf };
-  bar::agg_gc_t gc{ pix };
+/* eases what widget i of m shows from `from` to `to`, the frame clock ticks until it arrives */
+void animatebar(Monitor *m, unsigned int i, double from, double to) {
+  if(animduration <= 0 || from == to)
+    return;
+  frameclock.animate({ m, i }, from, to, loop.now(), animduration);
+  if(!frametimer.is_active())
+    frametimer.start(frameinterval());
+}
 
-  const auto &layo = m->barlayo;
-  const auto &attr = barattr;
+/* paced by the fastest output showing an animation */
+double frameinterval(void) {
+  return frameclock.interval(frameclock.max_over([](const std::pair<Monitor *, unsigned int> &t) { return t.first->refresh; }));
+}
 
-  gc.draw_text_panel(stext, layo.logo_, attr, bar::panel_flavor_t::logo);
-  m->barclick.emplace_back(layo.logo_, ClkStatusText);
-  static int nn = 0;
-  auto zoned = date::make_zoned(date::current_zone(), std::chrono::system_clock::now());
-  auto local = zoned.get_local_time();
-  auto tod = date::make_time(local - date::floor<date::days>(local));
-  gc.draw_text_panel(fmt::format("{:02}:{:02}:{:02}", tod.hours().count(), tod.minutes().count(), tod.seconds().count()), layo.time_, attr,
-                     bar::panel_flavor_t::datetime);
+/* one frame, only the widgets still animating are recorded, the timer is not rearmed once none is */
+void timerframe(ev::timer &, int) {
+  frameclock.tick(loop.now(), [](const std::pair<Monitor *, unsigned int> &t) { t.first->bardirty |= 1u << t.second; });
+  recorddue();
+  if(frameclock.active())
+    frametimer.start(frameinterval());
+  drainxevent();
+}
+
+void keystatus(Monitor *, WidgetState &w) { w.key.add(std::string_view{ stext }); }
+
+void recordstatus(Monitor *, WidgetState &w) { barrec.draw_text_panel(stext, w.z, barattr, bar::panel_flavor_t::logo); }
+
+/* with a single tag in view its highlight slides over from the previous one, goal and value count in tags and
+   are -1 while several tags are viewed */
+void keytags(Monitor *m, WidgetState &w) {
+  unsigned int i = &w - m->barwidgets.data();
+  unsigned int occ = 0, urg = 0, sel = m->tagset[m->seltags];
+  double goal = sel && !(sel & (sel - 1)) ? __builtin_ctz(sel) : -1;
+  Client *c;
+
+  for(c = m->clients; c; c = c->next) {
+    occ |= c->tags;
+    if(c->isurgent)
+      urg |= c->tags;
+  }
+  if(goal != w.goal) {
+    if(goal >= 0 && w.goal >= 0)
+      animatebar(m, i, w.value, goal);
+    else
+      frameclock.cancel({ m, i });
+    w.goal = goal;
+  }
+  w.value = frameclock.value({ m, i }, goal);
+  w.key.add(sel).add(occ).add(urg).add(w.value);
+}
+
+void recordtags(Monitor *m, WidgetState &w) {
+  unsigned int occ = 0, urg = 0;
+  Client *c;
+  auto &rec = barrec;
 
   for(c = m->clients; c; c = c->next) {
-    if(ISVISIBLE(c))
-      n++;
     occ |= c->tags;
     if(c->isurgent)
       urg |= c->tags;
   }
 
-  gc.draw_panel_bg(layo.tags_, bar::panel_flavor_t::tagsel);
-  auto z_tags = bar::xsplit(layo.tags_, LENGTH(tags));
+  rec.draw_panel_bg(w.z, bar::panel_flavor_t::tagsel);
+  auto z_tags = bar::xsplit(w.z, LENGTH(tags));
+  if(w.value >= 0) {
+    bar::zone_t z = z_tags[0];
+    z.x += w.value * z.w;
+    rec.draw_panel_bg(z, bar::panel_flavor_t::tagsel_active);
+  }
   for(int i = 0; i < LENGTH(tags); i++) {
     auto flavor = bar::panel_flavor_t::tagsel;
     if(m->tagset[m->seltags] & (1 << i)) {
       flavor = bar::panel_flavor_t::tagsel_active;
-      gc.draw_panel_bg(z_tags[i], flavor);
+      if(w.value < 0)
+        rec.draw_panel_bg(z_tags[i], flavor);
     }
-    gc.draw_text(tags[i], z_tags[i], attr, flavor);
-    m->barclick.emplace_back(z_tags[i], ClkTagBar);
+    rec.draw_text(tags[i], z_tags[i], barattr, flavor);
     Arg arg;
     arg.ui = 1 << i;
-    m->barclickarg.emplace_back(z_tags[i], arg);
+    w.clickarg.emplace_back(z_tags[i], arg);
     if(urg & (1 << i)) {
-      gc.draw_panel_pin(z_tags[i], bar::panel_flavor_t::tagsel_urg);
+      rec.draw_panel_pin(z_tags[i], bar::panel_flavor_t::tagsel_urg);
     } else if(occ & (1 << i)) {
-      gc.draw_panel_pin(z_tags[i], bar::panel_flavor_t::tagsel_occ);
+      rec.draw_panel_pin(z_tags[i], bar::panel_flavor_t::tagsel_occ);
     }
   }
+}
+
+void keyltbutton(Monitor *m, WidgetState &w) { w.key.add(m->lticon); }
+
+void recordltbutton(Monitor *m, WidgetState &w) {
+  barrec.draw_panel_bg(w.z, bar::panel_flavor_t::ltbutton);
+  barrec.draw_ltbutton_icon(m->lticon, w.z, barattr, bar::panel_flavor_t::ltbutton);
+}
 
-  gc.draw_panel_bg(layo.ltbutton_, bar::panel_flavor_t::ltbutton);
-  gc.draw_ltbutton_icon(m->lticon, layo.ltbutton_, attr, bar::panel_flavor_t::ltbutton);
-  m->barclick.emplace_back(layo.ltbutton_, ClkLtSymbol);
+/* titles are fetched here, so a title only ever shown in a covered bar is never read */
+void keywins(Monitor *m, WidgetState &w) {
+  Client *c;
 
-  gc.draw_panel_bg(layo.wins_, bar::panel_flavor_t::winsel);
-  auto z_wins = bar::xsplit(layo.wins_, n);
-  i = 0;
+  for(c = m->clients; c; c = c->next) {
+    if(!ISVISIBLE(c))
+      continue;
+    if(c->titledirty)
+      updatetitle(c);
+    w.key.add(c).add(c == m->sel).add(HIDDEN(c) || (m->hidsel && m->sel == c)).add(std::string_view{ c->name });
+  }
+}
+
+void recordwins(Monitor *m, WidgetState &w) {
+  int n = 0, i = 0;
+  Client *c;
+  auto &rec = barrec;
+
+  for(c = m->clients; c; c = c->next)
+    if(ISVISIBLE(c))
+      n++;
+
+  rec.draw_panel_bg(w.z, bar::panel_flavor_t::winsel);
+  auto z_wins = bar::xsplit(w.z, n);
   for(c = m->clients; c; c = c->next) {
     auto flavor = bar::panel_flavor_t::winsel;
     if(!ISVISIBLE(c))
       continue;
     if(m->sel == c) {
       flavor = bar::panel_flavor_t::winsel_active;
-      gc.draw_panel_bg(z_wins[i], flavor);
+      rec.draw_panel_bg(z_wins[i], flavor);
     }
-    gc.draw_text(c->name, z_wins[i], attr, flavor);
+    rec.draw_text(c->name, z_wins[i], barattr, flavor);
     if(HIDDEN(c) || (m->hidsel && m->sel == c)) {
-      gc.draw_panel_pin(z_wins[i], bar::panel_flavor_t::winsel_hidden);
+      rec.draw_panel_pin(z_wins[i], bar::panel_flavor_t::winsel_hidden);
     }
-    m->barclick.emplace_back(z_wins[i], ClkWinTitle);
     Arg arg;
     arg.v = c;
-    m->barclickarg.emplace_back(z_wins[i], arg);
+    w.clickarg.emplace_back(z_wins[i], arg);
     i++;
   }
+}
+
+void keyclock(Monitor *, WidgetState &w) {
+  auto tod = localclock.now();
+  w.key.add(tod.hours).add(tod.minutes).add(clockseconds ? tod.seconds : 0u);
+}
+
+void recordclock(Monitor *, WidgetState &w) {
+  char buf[16];
+  auto tod = localclock.now();
+  fmt::format_to_n_result<char *> res;
+  if(clockseconds)
+    res = fmt::format_to_n(buf, sizeof buf, "{:02}:{:02}:{:02}", tod.hours, tod.minutes, tod.seconds);
+  else
+    res = fmt::format_to_n(buf, sizeof buf, "{:02}:{:02}", tod.hours, tod.minutes);
+  barrec.draw_text_panel(std::string_view{ buf, res.size }, w.z, barattr, bar::panel_flavor_t::datetime);
+}
 
 #ifndef DWMZ_NO_WP
-  double vshow = 1.0;
+static double volumeshown(void) {
   auto vres = vol.get_result();
-  if(vres) {
-    vshow = vres->volume;
-    if(vres->mute)
-      vshow = 0.0;
+  if(!vres)
+    return 1.0;
+  return vres->mute ? 0.0 : vres->volume;
+}
+
+/* the bar slides to a new volume instead of jumping */
+void keyvolume(Monitor *m, WidgetState &w) {
+  unsigned int i = &w - m->barwidgets.data();
+  double goal = volumeshown();
+
+  if(goal != w.goal) {
+    animatebar(m, i, w.value, goal);
+    w.goal = goal;
   }
-  gc.draw_volbar_panel(vshow, layo.volume_, attr, bar::panel_flavor_t::volume);
+  w.value = frameclock.value({ m, i }, goal);
+  w.key.add(w.value);
+}
+
+void recordvolume(Monitor *, WidgetState &w) { barrec.draw_volbar_panel(w.value, w.z, barattr, bar::panel_flavor_t::volume); }
 #endif
 
 #ifndef DWMZ_NO_FCITX
-  std::string im_is = "-";
+static const char *imshown(void) {
   std::string im_s = imc.get_im();
-  if(im_s == "keyboard-us") {
-    im_is = "EN";
+  if(im_s == "keyboard-us")
+    return "EN";
+  if(im_s == "pinyin")
+    return "拼";
+  return "-";
+}
+
+void keyim(Monitor *, WidgetState &w) { w.key.add(std::string_view{ imshown() }); }
+
+void recordim(Monitor *, WidgetState &w) { barrec.draw_text_panel(imshown(), w.z, barattr, bar::panel_flavor_t::im); }
+#endif
+
+void drawbars(void) { markbars(SrcWm); }
+
+void shmcompletion(XEvent *e) { shmpool.handle_event(*e); }
+
+/* a bar nobody can see is neither recorded nor rendered */
+int barvisible(Monitor *m) {
+  Client *c;
+
+  if(!m->showbar || m->barobscured || screenoff || saveron)
+    return 0;
+  for(c = m->clients; c; c = c->next)
+    if(c->isfullscreen && ISVISIBLE(c) && !HIDDEN(c))
+      return 0;
+  return 1;
+}
+
+/* a bar coming back gets one full catch-up frame for everything it missed, with no bar up the widget timers sleep */
+void updatebarvis(void) {
+  static int anyvis;
+  Monitor *m;
+  unsigned int i;
+  int vis, any = 0;
+
+  for(m = mons; m; m = m->next) {
+    vis = barvisible(m);
+    if(vis && !m->barvis)
+      markbar(m, ~0u);
+    m->barvis = vis;
+    any |= vis;
   }
-  if(im_s == "pinyin") {
-    im_is = "拼";
+  if(!widgetsarmed || any == anyvis)
+    return;
+  anyvis = any;
+  for(i = 0; i < LENGTH(widgets); i++) {
+    if(widgets[i].period <= 0)
+      continue;
+    if(any)
+      widgettimers[i].start(0., widgets[i].period);
+    else
+      widgettimers[i].stop();
   }
-  gc.draw_text_panel(im_is, layo.im_, attr, bar::panel_flavor_t::im);
-#endif
+}
+
+/* DPMS sends no events, it is polled on its own timer */
+void pollscreen(void) {
+  CARD16 level;
+  BOOL enabled;
+  int off;
+
+  if(!dpmsext)
+    return;
+  off = DPMSInfo(dpy, &level, &enabled) && enabled && level != DPMSModeOn;
+  if(off != screenoff) {
+    screenoff = off;
+    updatebarvis();
+  }
+}
 
-  XPutImage(dpy, m->barwin, drw->gc, &m->barimg, 0, 0, 0, 0, m->ww, bh);
-  XSync(drw->dpy, False);
+void timerdpms(ev::timer &, int) {
+  pollscreen();
+  drainxevent();
+}
+
+void screensavernotify(XEvent *e) {
+  XScreenSaverNotifyEvent *ev = (XScreenSaverNotifyEvent *)e;
+
+  saveron = ev->state == ScreenSaverOn || ev->state == ScreenSaverCycle;
+  drawbars();
 }
 
-void drawbars(void) {
+void visibilitynotify(XEvent *e) {
   Monitor *m;
+  XVisibilityEvent *ev = &e->xvisibility;
 
-  for(m = mons; m; m = m->next)
+  if((m = wintomon(ev->window)) && ev->window == m->barwin) {
+    m->barobscured = ev->state == VisibilityFullyObscured;
     drawbar(m);
+  }
 }
 
 void expose(XEvent *e) {
   Monitor *m;
   XExposeEvent *ev = &e->xexpose;
 
-  if(ev->count == 0 && (m = wintomon(ev->window))) {
-    drawbar(m);
-  }
+  if((m = wintomon(ev->window)) && ev->window == m->barwin && m->barpm)
+    XCopyArea(dpy, m->barpm, m->barwin, drw->gc, ev->x, ev->y, ev->width, ev->height, ev->x, ev->y);
 }
 
 void focus(Client *c) {
@@ -1290,6 +1810,7 @@ void manage(Window w, XWindowAttributes *wa) {
 
   c = (Client *)ecalloc(1, sizeof(Client));
   c->win = w;
+  c->wmstate = getstate(w); /* a window hidden before a restart stays hidden */
   /* geometry */
   c->x = c->oldx = wa->x;
   c->y = c->oldy = wa->y;
@@ -1387,6 +1908,7 @@ void movemouse(const Arg *arg) {
   if(c->isfullscreen) /* no support moving fullscreen windows by mouse */
     return;
   restack(selmon);
+  flushdeferred();
   ocx = c->x;
   ocy = c->y;
   if(XGrabPointer(dpy, root, False, MOUSEMASK, GrabModeAsync, GrabModeAsync, None, cursor[CurMove]->cursor, CurrentTime) != GrabSuccess)
@@ -1400,6 +1922,7 @@ void movemouse(const Arg *arg) {
     case Expose:
     case MapRequest:
       handler[ev.type](&ev);
+      flushdeferred(); /* the main loop is blocked until the button is released */
       break;
     case MotionNotify:
       if((ev.xmotion.time - lasttime) <= (1000 / 60))
@@ -1420,6 +1943,7 @@ void movemouse(const Arg *arg) {
         togglefloating(NULL);
       if(!selmon->lt[selmon->sellt]->arrange || c->isfloating)
         resize(c, nx, ny, c->w, c->h, 1);
+      flushdeferred();
       break;
     }
   } while(ev.type != ButtonRelease);
@@ -1470,9 +1994,9 @@ void propertynotify(XEvent *e) {
       break;
     }
     if(ev->atom == XA_WM_NAME || ev->atom == netatom[NetWMName]) {
-      updatetitle(c);
-      if(c == c->mon->sel)
-        drawbar(c->mon);
+      c->titledirty = 1;
+      if(INBAR(c))
+        scheduletitle(c);
     }
     if(ev->atom == netatom[NetWMWindowType])
       updatewindowtype(c);
@@ -1564,6 +2088,7 @@ void resizemouse(const Arg *arg) {
   if(c->isfullscreen) /* no support resizing fullscreen windows by mouse */
     return;
   restack(selmon);
+  flushdeferred();
   ocx = c->x;
   ocy = c->y;
   if(XGrabPointer(dpy, root, False, MOUSEMASK, GrabModeAsync, GrabModeAsync, None, cursor[CurResize]->cursor, CurrentTime) != GrabSuccess)
@@ -1576,6 +2101,7 @@ void resizemouse(const Arg *arg) {
     case Expose:
     case MapRequest:
       handler[ev.type](&ev);
+      flushdeferred(); /* the main loop is blocked until the button is released */
       break;
     case MotionNotify:
       if((ev.xmotion.time - lasttime) <= (1000 / 60))
@@ -1591,6 +2117,7 @@ void resizemouse(const Arg *arg) {
       }
       if(!selmon->lt[selmon->sellt]->arrange || c->isfloating)
         resize(c, c->x, c->y, nw, nh, 1);
+      flushdeferred();
       break;
     }
   } while(ev.type != ButtonRelease);
@@ -1606,11 +2133,15 @@ void resizemouse(const Arg *arg) {
 }
 
 void restack(Monitor *m) {
+  drawbar(m);
+  m->deferred |= DeferRestack;
+}
+
+void restacknow(Monitor *m) {
   Client *c;
   XEvent ev;
   XWindowChanges wc;
 
-  drawbar(m);
   if(!m->sel)
     return;
   if(m->sel->isfloating || !m->lt[m->sellt]->arrange)
@@ -1640,36 +2171,159 @@ void drainxevent() {
 
 void drainxevent_io(ev::io &, int) { drainxevent(); }
 
-void timerdrawbars(ev::timer &, int) {
-  drawbars();
+/* carries out what the handlers of this loop iteration asked for, every monitor is arranged, restacked and recorded at most once */
+void flushdeferred(void) {
+  Monitor *m;
+
+  for(m = mons; m; m = m->next)
+    if(m->deferred & DeferArrange)
+      showhide(m->stack);
+  for(m = mons; m; m = m->next)
+    if(m->deferred & DeferArrange)
+      arrangemon(m);
+  for(m = mons; m; m = m->next)
+    if(m->deferred & DeferRestack)
+      restacknow(m);
+  if(clientlistdirty) {
+    clientlistdirty = 0;
+    updateclientlistnow();
+  }
+  updatebarvis();
+  for(m = mons; m; m = m->next) {
+    if(m->deferred & DeferBar)
+      recordbar(m);
+    m->deferred = 0;
+  }
+  submitbars();
+}
+
+int deferredpending(void) {
+  Monitor *m;
+
+  for(m = mons; m; m = m->next)
+    if(m->deferred)
+      return 1;
+  return clientlistdirty;
+}
+
+/* runs before the loop blocks, restacking syncs and events it pulled into the queue would not wake the io watcher */
+void preparedeferred(ev::prepare &, int) {
+  while(deferredpending()) {
+    flushdeferred();
+    drainxevent();
+  }
+  XFlush(dpy);
+}
+
+/* the zone (or its rules) changed under us, drop the cached offset */
+void statlocaltime(ev::stat &, int) {
+  localclock.invalidate();
+  markbars(SrcTime);
+}
+
+/* fires on wall clock boundaries for one widget with a period and records only that one */
+void periodicwidget(ev::periodic &w, int) {
+  unsigned int i = &w - widgettimers;
+  Monitor *m;
+#ifdef DWMZ_COUNT_ALLOCS
+  /* once the run cache is full every new clock string takes over an evicted slot, from then on a tick stays off the heap */
+  bool steady;
+  {
+    std::lock_guard<std::mutex> lock{ bar::font_mutex() };
+    steady = bar::fruns().full();
+  }
+  ytk::alloc_scope_t allocs;
+#endif
+
+  for(m = mons; m; m = m->next)
+    m->bardirty |= 1u << i;
+  recorddue();
+#ifdef DWMZ_COUNT_ALLOCS
+  assert(!steady || allocs.count() == 0);
+#endif
   drainxevent();
 }
 
-static ev::async a_drawbars;
+void asyncuploadbars(ev::async &, int) {
+  uploadbarframe();
+  drainxevent();
+}
 
 void asyncdrawbars(ev::async &, int) {
-  drawbars();
+  markbars(asyncsrc.exchange(0));
   drainxevent();
 }
 
+void sigusr1fontcache(ev::sig &, int) {
+  std::lock_guard<std::mutex> lock{ bar::font_mutex() };
+  const auto &fonts = bar::fctx().stats();
+  const auto &glyphs = bar::fctx().glyph_stats();
+  const auto &masks = bar::gmasks().stats();
+  ytk::log::info("font cache: budget={} bytes", bar::fbudget().bytes_);
+  ytk::log::info("font cache: faces {} items {} bytes, hits={} misses={} evictions={}", fonts.items, fonts.bytes, fonts.hits, fonts.misses, fonts.evictions);
+  ytk::log::info("font cache: outlines {} items, hits={} misses={} evictions={}", glyphs.items, glyphs.hits, glyphs.misses, glyphs.evictions);
+  ytk::log::info("font cache: masks {} items {} bytes, hits={} misses={} evictions={}", masks.items, masks.bytes, masks.hits, masks.misses, masks.evictions);
+}
+
 void run(void) {
+  unsigned int i;
+
+  /* input first, timers and bar uploads only run in iterations with no X events pending */
   ev::io x_io;
   x_io.set(ConnectionNumber(dpy), ev::READ);
   x_io.set<&drainxevent_io>();
+  ev_set_priority(&x_io, EV_MAXPRI);
   x_io.start();
 
-  ev::timer tim;
-  tim.set<&timerdrawbars>();
-  tim.start(1., 1.);
+  ev::prepare deferred;
+  deferred.set<&preparedeferred>();
+  deferred.start();
+
+  for(i = 0; i < LENGTH(widgets); i++) {
+    if(widgets[i].period <= 0)
+      continue;
+    widgettimers[i].set<&periodicwidget>();
+    ev_set_priority(&widgettimers[i], EV_MINPRI);
+  }
+  widgetsarmed = 1;
+  updatebarvis();
+
+  if(dpmsext) {
+    dpmstimer.set<&timerdpms>();
+    ev_set_priority(&dpmstimer, EV_MINPRI);
+    dpmstimer.start(dpmspoll, dpmspoll);
+  }
+
+  titletimer.set<&timertitles>();
+  frametimer.set<&timerframe>();
+
+  ev::stat localtime;
+  localtime.set<&statlocaltime>();
+  localtime.start("/etc/localtime");
 
   a_drawbars.set<&asyncdrawbars>();
   a_drawbars.start();
+
+  /* a frame finished before the loop started has no pending wakeup */
+  a_barframe.set<&asyncuploadbars>();
+  a_barframe.start();
+  uploadbarframe();
+
+  ev::sig usr1;
+  usr1.set<&sigusr1fontcache>();
+  usr1.start(SIGUSR1);
 #ifndef DWMZ_NO_WP
-  vol.on_update([]() { a_drawbars.send(); });
+  vol.on_update([]() {
+    asyncsrc |= SrcVolume;
+    a_drawbars.send();
+  });
   vol.run();
 #endif
 #ifndef DWMZ_NO_FCITX
-  imc.on_update([]() { a_drawbars.send(); });
+  imc.on_update([]() {
+    asyncsrc |= SrcIm;
+    a_drawbars.send();
+  });
   imc.run();
 #endif
 
@@ -1719,6 +2373,7 @@ void sendmon(Client *c, Monitor *m) {
 void setclientstate(Client *c, long state) {
   long data[] = { state, None };
 
+  c->wmstate = state;
   XChangeProperty(dpy, c->win, wmatom[WMState], wmatom[WMState], 32, PropModeReplace, (unsigned char *)data, 2);
 }
 
@@ -1763,6 +2418,7 @@ void setfullscreen(Client *c, int fullscreen) {
     c->isfloating = 1;
     resizeclient(c, c->mon->mx, c->mon->my, c->mon->mw, c->mon->mh);
     XRaiseWindow(dpy, c->win);
+    drawbar(c->mon); /* the bar is covered now */
   } else if(!fullscreen && c->isfullscreen) {
     XChangeProperty(dpy, c->win, netatom[NetWMState], XA_ATOM, 32, PropModeReplace, (unsigned char *)0, 0);
     c->isfullscreen = 0;
@@ -1825,6 +2481,15 @@ void setup(void) {
   bh = sh * bh_ratio;
   root = RootWindow(dpy, screen);
   xinitvisual();
+  shmpool.init(dpy);
+  barpool = std::make_unique<ytk::worker_pool_t>(std::min(barworkers, std::max(std::thread::hardware_concurrency(), 1u) - 1));
+  if(barxrender && bar::xrender_gc_t::available(dpy))
+    barxr = std::make_unique<bar::xrender_gc_t>(dpy);
+  else
+    barthread = std::thread(barrenderloop);
+  if(shmpool.completion_type() >= 0)
+    handler[shmpool.completion_type()] = shmcompletion;
+  xinitscreensaver();
   drw = drw_create(dpy, screen, root, visual, depth, cmap);
   updategeom();
   /* init atoms */
@@ -2106,14 +2771,18 @@ void unmapnotify(XEvent *e) {
 
 void updatebars(void) {
   Monitor *m;
+  unsigned int i;
+  bar::row_item_t items[LENGTH(widgets)];
+  bar::zone_t zones[LENGTH(widgets)];
   XSetWindowAttributes wa;
   wa.override_redirect = True;
   wa.background_pixel = 0;
   wa.border_pixel = 0;
   wa.colormap = cmap;
-  wa.event_mask = ButtonPressMask | ExposureMask;
+  wa.event_mask = ButtonPressMask | ExposureMask | VisibilityChangeMask;
   static char chs[] = "dwm";
   XClassHint ch = { chs, chs };
+  syncbars();
   for(m = mons; m; m = m->next) {
     if(m->barwin) {
       XMoveResizeWindow(dpy, m->barwin, m->wx, m->by, m->ww, bh);
@@ -2121,32 +2790,23 @@ void updatebars(void) {
       m->barwin = XCreateWindow(dpy, root, m->wx, m->by, m->ww, bh, 0, depth, InputOutput, visual,
                                 CWOverrideRedirect | CWBackPixel | CWBorderPixel | CWColormap | CWEventMask, &wa);
     }
-    bar::layout_flag_t flags = 0;
-#ifndef DWMZ_NO_WP
-    flags |= bar::layout_flags::has_volume;
-#endif
-#ifndef DWMZ_NO_FCITX
-    flags |= bar::layout_flags::has_im;
-#endif
-    m->barlayo = bar::layout_wmbar(m->ww, bh, LENGTH(tags), flags);
-    m->bardata.resize(m->ww * bh * 4);
-    m->barimg.width = m->ww;
-    m->barimg.height = bh;
-    m->barimg.xoffset = 0;
-    m->barimg.format = ZPixmap;
-    m->barimg.data = reinterpret_cast<char *>(m->bardata.data());
-    m->barimg.byte_order = ImageByteOrder(dpy);
-    m->barimg.bitmap_unit = 32;
-    m->barimg.bitmap_bit_order = ImageByteOrder(dpy);
-    m->barimg.bitmap_pad = 32;
-    m->barimg.depth = depth == 32 ? 32 : 24;
-    m->barimg.bits_per_pixel = 32;
-    m->barimg.bytes_per_line = m->ww * 4;
-    m->barimg.red_mask = 0x00ff0000;
-    m->barimg.green_mask = 0x0000ff00;
-    m->barimg.blue_mask = 0x000000ff;
-    m->barimg.obdata = 0;
-    XInitImage(&m->barimg);
+    for(i = 0; i < LENGTH(widgets); i++)
+      items[i] = bar::row_item_t{ widgets[i].edge, std::round(bh * widgets[i].width) };
+    bar::layout_row(m->ww, bh, items, LENGTH(widgets), zones);
+    for(i = 0; i < LENGTH(widgets); i++)
+      m->barwidgets[i].z = zones[i];
+    m->refresh = ytk::x::refresh_rate(dpy, root, m->mx, m->my, m->mw, m->mh);
+    if(m->barimg[0].width() != (unsigned)m->ww || m->barimg[0].height() != (unsigned)bh) {
+      m->barimg[0].create(shmpool, visual, depth == 32 ? 32 : 24, m->ww, bh);
+      m->barimg[1].create(shmpool, visual, depth == 32 ? 32 : 24, m->ww, bh);
+      if(m->barpict)
+        XRenderFreePicture(dpy, m->barpict);
+      if(m->barpm)
+        XFreePixmap(dpy, m->barpm);
+      m->barpm = XCreatePixmap(dpy, root, m->ww, bh, depth);
+      m->barimg[0].put(m->barpm, drw->gc, 0, 0, 0, 0, m->ww, bh);
+      m->barpict = barxr ? XRenderCreatePicture(dpy, m->barpm, XRenderFindVisualFormat(dpy, visual), 0, NULL) : None;
+    }
 
     XDefineCursor(dpy, m->barwin, cursor[CurNormal]->cursor);
     XMapRaised(dpy, m->barwin);
@@ -2172,7 +2832,9 @@ void updatebarpos(Monitor *m) {
     m->by = -bh;
 }
 
-void updateclientlist() {
+void updateclientlist() { clientlistdirty = 1; }
+
+void updateclientlistnow() {
   Client *c;
   Monitor *m;
 
@@ -2260,11 +2922,39 @@ int updategeom(void) {
 
 void updatebg(Monitor *m) {
   if(bg_path) {
-    setbg::png_lanczos::draw_png(bg_path, dpy, bg_pm, root_gc, m->mx, m->my, m->mw, m->mh, DefaultDepth(dpy, screen));
+    setbg::png_lanczos::draw_png(bg_path, shmpool, bg_pm, root_gc, m->mx, m->my, m->mw, m->mh, DefaultDepth(dpy, screen),
+                                 [m](ytk::x::shm_image_t &wall) { updatebardrop(m, wall); });
   }
 }
 
+/* blurs and tints the wallpaper strip under the bar once per wallpaper or geometry change, a frame only copies it */
+void updatebardrop(Monitor *m, ytk::x::shm_image_t &wall) {
+  Pixmap pm;
+  XImage *img;
+
+  if(m->bardroppict)
+    XRenderFreePicture(dpy, m->bardroppict);
+  m->bardroppict = None;
+  m->bardrop = bar::backdrop_t{};
+  if(!barfrost)
+    return;
+  m->bardrop = bar::make_backdrop(wall.data(), wall.stride(), wall.width(), wall.height(), m->wx - m->mx, m->topbar ? 0 : m->mh - bh, m->ww, bh,
+                                  std::lround(bh * barfrostblur), bar::theme_color(barfrosttint, barfrostalpha));
+  if(!barxr || m->bardrop.empty())
+    return;
+  /* the picture keeps the pixmap alive */
+  pm = XCreatePixmap(dpy, root, m->bardrop.w, m->bardrop.h, depth);
+  img = XCreateImage(dpy, visual, depth, ZPixmap, 0, (char *)m->bardrop.px.data(), m->bardrop.w, m->bardrop.h, 32, m->bardrop.stride());
+  XPutImage(dpy, pm, drw->gc, img, 0, 0, 0, 0, m->bardrop.w, m->bardrop.h);
+  img->data = NULL;
+  XDestroyImage(img);
+  m->bardroppict = XRenderCreatePicture(dpy, pm, XRenderFindVisualFormat(dpy, visual), 0, NULL);
+  XFreePixmap(dpy, pm);
+}
+
 void updatebgs(void) {
+  /* the render thread reads the backdrops, and every zone has to be redrawn over the new ones */
+  syncbars();
   if(bg_pm) {
     XFreePixmap(dpy, bg_pm);
   }
@@ -2341,10 +3031,36 @@ void updatesizehints(Client *c) {
 void updatestatus(void) {
   if(!gettextprop(root, XA_WM_NAME, stext, sizeof(stext)))
     strcpy(stext, "dwmZ");
-  drawbar(selmon);
+  markbars(SrcStatus);
+}
+
+/* refetches at most every titlerate seconds, the bar zone is only rerendered if the visible part of the title changed */
+void scheduletitle(Client *c) {
+  double due = c->titletime + titlerate;
+
+  if(loop.now() >= due) {
+    updatetitle(c);
+    drawbar(c->mon);
+  } else if(!titletimer.is_active() || titletimer.remaining() > due - loop.now()) {
+    titletimer.stop();
+    titletimer.start(due - loop.now());
+  }
+}
+
+void timertitles(ev::timer &, int) {
+  Monitor *m;
+  Client *c;
+
+  for(m = mons; m; m = m->next)
+    for(c = m->clients; c; c = c->next)
+      if(c->titledirty && INBAR(c))
+        scheduletitle(c);
+  drainxevent();
 }
 
 void updatetitle(Client *c) {
+  c->titledirty = 0;
+  c->titletime = loop.now();
   if(!gettextprop(c->win, netatom[NetWMName], c->name, sizeof c->name))
     gettextprop(c->win, XA_WM_NAME, c->name, sizeof c->name);
   if(c->name[0] == '\0') /* hack to mark broken clients */
@@ -2468,6 +3184,24 @@ void xinitvisual() {
   }
 }
 
+/* both are optional, without them the bar is only suspended for obscured or fullscreen covered monitors */
+void xinitscreensaver(void) {
+  int evbase, errbase;
+  XScreenSaverInfo *info;
+
+  dpmsext = DPMSQueryExtension(dpy, &evbase, &errbase) && DPMSCapable(dpy);
+  if(XScreenSaverQueryExtension(dpy, &evbase, &errbase)) {
+    handler[evbase + ScreenSaverNotify] = screensavernotify;
+    XScreenSaverSelectInput(dpy, root, ScreenSaverNotifyMask);
+    if((info = XScreenSaverAllocInfo())) {
+      if(XScreenSaverQueryInfo(dpy, root, info))
+        saveron = info->state == ScreenSaverOn;
+      XFree(info);
+    }
+  }
+  pollscreen();
+}
+
 void zoom(const Arg *arg) {
   Client *c = selmon->sel;
 
@@ -2492,6 +3226,9 @@ void loadcfg(void) {
   if(str = getenv("DWMZ_LOCK")) {
     lockcmdptr = str;
   }
+  if(str = getenv("DWMZ_FONT_CACHE_MB")) {
+    bar::fbudget().bytes_ = std::strtoul(str, NULL, 10) << 20;
+  }
 }
 
 int main(int argc, char *argv[]) {
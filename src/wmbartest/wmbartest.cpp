@@ -4,6 +4,7 @@
 
 #include "ytk/event/event_types.hpp"
 #include "ytk/event/registry.hpp"
+#include "ytk/misc/frame_clock.hpp"
 #include "ytk/x/x.hpp"
 
 #include "bar/gc/gc.hpp"
@@ -21,6 +22,8 @@
 bar::wmbar_layout_t layo;
 bar::zone_attr_t attr;
 ytk::x::win_t win;
+ytk::frame_clock_t<int> anims; // 0 is the volume bar
+double volume = 0.7;
 std::atomic<bool> exiting = ATOMIC_VAR_INIT(false);
 
 void request_exit(const ytk::event::app_exit_t &) { exiting = true; }
@@ -32,7 +35,7 @@ void redraw() {
     gc.draw_text_panel("dwmZ", layo.logo_, attr, bar::panel_flavor_t::logo);
     gc.draw_text_panel("23:59", layo.time_, attr, bar::panel_flavor_t::datetime);
     gc.draw_text_panel("EN", layo.im_, attr, bar::panel_flavor_t::im);
-    gc.draw_volbar_panel(0.7, layo.volume_, attr, bar::panel_flavor_t::volume);
+    gc.draw_volbar_panel(anims.value(0, volume), layo.volume_, attr, bar::panel_flavor_t::volume);
     auto z_tags = bar::xsplit(layo.tags_, 9);
     for(int i = 0; i < 9; i++) {
       if(i == 3) {
@@ -62,6 +65,18 @@ int main(void) {
   attr.volbar_ratio = 0.2;
 
   ytk::event::set_handler<ytk::event::app_exit_t>([](const auto &) { exiting = true; });
+  // any key slides the volume bar to the other end, redrawn on the window's frame clock until it arrives
+  ytk::event::set_handler<ytk::event::key_press_t>([](const auto &) {
+    double to = volume > 0.5 ? 0.2 : 0.9;
+    anims.animate(0, anims.value(0, volume), to, win.steady_now(), 0.3);
+    volume = to;
+    win.set_animating(true);
+  });
+  ytk::event::set_handler<ytk::event::frame_t>([](const ytk::event::frame_t &f) {
+    anims.tick(f.now, [](int) {});
+    redraw();
+    win.set_animating(anims.active());
+  });
   ytk::event::set_handler<ytk::event::expose_t>([](const auto &) { redraw(); });
   ytk::event::set_handler<ytk::event::win_resize_t>([](const ytk::event::win_resize_t &rsz) {
     layo = bar::layout_wmbar(rsz.width, std::min<double>(100, rsz.height), 9, bar::layout_flags::has_im | bar::layout_flags::has_volume);